@@ -11,8 +11,10 @@
 #include "NavBar.h"
 #include "ContentPanel.h"
 #include "ThemezerAPI.h"
+#include "ThemezerCatalog.h"
 #include "ImageLoader.h"
 #include "DownloadManager.h"
+#include "UpdateChecker.h"
 #include "Camera.h"
 #include "utils.h"
 
@@ -248,6 +250,8 @@ namespace App {
         Camera::open();
 
         DownloadManager::initialize(user_agent);
+        UpdateChecker::initialize();
+        ThemezerCatalog::initialize();
         ImageLoader::initialize(renderer);
         NavBar::initialize(renderer);
         ContentPanel::initialize(renderer);
@@ -287,6 +291,8 @@ namespace App {
         NavBar::finalize();
         ContentPanel::finalize();
         ImageLoader::finalize();
+        ThemezerCatalog::finalize();
+        UpdateChecker::finalize();
         DownloadManager::finalize();
 
         Camera::close();
@@ -311,6 +317,8 @@ namespace App {
         isRunning = true;
 
         while (isRunning) {
+            ImageLoader::new_frame();
+
             try {
                 ThemezerAPI::process();
             }
@@ -325,6 +333,20 @@ namespace App {
                 cerr << "ERROR in DownloadManager::process(): " << e.what() << endl;
             }
 
+            try {
+                UpdateChecker::process();
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR in UpdateChecker::process(): " << e.what() << endl;
+            }
+
+            try {
+                ThemezerCatalog::process();
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR in ThemezerCatalog::process(): " << e.what() << endl;
+            }
+
             SDL_Event e;
             while(SDL_PollEvent(&e)) {
                 ImGui_ImplSDL2_ProcessEvent(&e);
@@ -8,8 +8,12 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cctype>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -19,12 +23,18 @@
 #include <ranges>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <curl/curl.h>
+#include <zlib.h>
 
 #include "DownloadManager.h"
+#include "ImageLoader.h"
+#include "async_queue.hpp"
+#include "curl_worker.hpp"
 #include "screens/DownloadThemePopup.h"
+#include "sha256.hpp"
 #include "utils.h"
 #include "tracer.hpp"
 
@@ -37,6 +47,216 @@ namespace DownloadManager {
 
     std::string user_agent;
 
+    // How many times a .utheme transfer is attempted before giving up.
+    const unsigned max_attempts = 3;
+
+    // Thrown when a finished .utheme doesn't look intact; always worth a retry.
+    class verification_error : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    namespace {
+
+        std::string_view trim(std::string_view s)
+        {
+            while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+                s.remove_prefix(1);
+            while (!s.empty() && (s.back() == ' ' || s.back() == '\t' ||
+                                  s.back() == '\r' || s.back() == '\n'))
+                s.remove_suffix(1);
+            return s;
+        }
+
+        bool iequals(std::string_view a, std::string_view b)
+        {
+            return std::ranges::equal(a, b, [](char x, char y) {
+                return std::tolower(static_cast<unsigned char>(x))
+                    == std::tolower(static_cast<unsigned char>(y));
+            });
+        }
+
+        std::optional<std::vector<std::uint8_t>> base64_decode(std::string_view input)
+        {
+            std::vector<std::uint8_t> result;
+            std::uint32_t acc = 0;
+            unsigned bits = 0;
+            for (char c : input) {
+                unsigned v;
+                if (c >= 'A' && c <= 'Z')
+                    v = c - 'A';
+                else if (c >= 'a' && c <= 'z')
+                    v = c - 'a' + 26;
+                else if (c >= '0' && c <= '9')
+                    v = c - '0' + 52;
+                else if (c == '+' || c == '-')
+                    v = 62;
+                else if (c == '/' || c == '_')
+                    v = 63;
+                else if (c == '=')
+                    break;
+                else
+                    return {};
+                acc = (acc << 6) | v;
+                bits += 6;
+                if (bits >= 8) {
+                    bits -= 8;
+                    result.push_back(static_cast<std::uint8_t>(acc >> bits));
+                }
+            }
+            return result;
+        }
+
+        // Extracts the sha-256 value from "Digest: sha-256=<b64>" or
+        // "Repr-Digest: sha-256=:<b64>:" (RFC 3230 and RFC 9530).
+        std::optional<sha256::digest_type> parse_sha256_digest(std::string_view value)
+        {
+            while (!value.empty()) {
+                auto comma = value.find(',');
+                auto item = trim(value.substr(0, comma));
+                value = comma == std::string_view::npos ? ""sv : value.substr(comma + 1);
+
+                auto eq = item.find('=');
+                if (eq == std::string_view::npos || !iequals(trim(item.substr(0, eq)), "sha-256"))
+                    continue;
+
+                auto encoded = trim(item.substr(eq + 1));
+                if (encoded.starts_with(':') && encoded.ends_with(':') && encoded.size() >= 2)
+                    encoded = encoded.substr(1, encoded.size() - 2);
+
+                auto raw = base64_decode(encoded);
+                if (!raw || raw->size() != sha256::digest_type{}.size())
+                    continue;
+
+                sha256::digest_type digest;
+                std::ranges::copy(*raw, digest.begin());
+                return digest;
+            }
+            return {};
+        }
+
+        std::uint16_t load_le16(const char* p)
+        {
+            auto u = reinterpret_cast<const unsigned char*>(p);
+            return std::uint16_t(u[0] | (u[1] << 8));
+        }
+
+        std::uint32_t load_le32(const char* p)
+        {
+            auto u = reinterpret_cast<const unsigned char*>(p);
+            return std::uint32_t{u[0]}
+                | (std::uint32_t{u[1]} << 8)
+                | (std::uint32_t{u[2]} << 16)
+                | (std::uint32_t{u[3]} << 24);
+        }
+
+    } // namespace
+
+    // Integrity state for a .utheme transfer, updated from the write callback.
+    struct StreamCheck {
+        // End of central directory record, plus the largest possible comment.
+        static constexpr std::size_t eocd_size = 22;
+        static constexpr std::size_t max_tail = eocd_size + 0xffff;
+
+        std::uint32_t crc = 0;
+        sha256 hasher;
+        std::uint64_t size = 0;
+        std::array<char, 4> head{};
+        std::vector<char> tail;
+
+        std::string content_encoding;
+        std::optional<sha256::digest_type> expected_sha256;
+
+        void reset()
+        {
+            crc = ::crc32(0L, Z_NULL, 0);
+            hasher.reset();
+            size = 0;
+            head = {};
+            tail.clear();
+            content_encoding.clear();
+            expected_sha256.reset();
+        }
+
+        void update(const char* data, std::size_t len)
+        {
+            crc = ::crc32(crc, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(len));
+            hasher.update(data, len);
+
+            for (std::size_t i = 0; size + i < head.size() && i < len; ++i)
+                head[size + i] = data[i];
+            size += len;
+
+            // Keep only the bytes that can contain the EOCD; trim lazily to avoid
+            // moving the buffer on every chunk.
+            tail.insert(tail.end(), data, data + len);
+            if (tail.size() > 2 * max_tail)
+                tail.erase(tail.begin(), tail.end() - max_tail);
+        }
+
+        void header(std::string_view line)
+        {
+            auto colon = line.find(':');
+            if (colon == std::string_view::npos)
+                return;
+
+            auto name = trim(line.substr(0, colon));
+            auto value = trim(line.substr(colon + 1));
+
+            if (iequals(name, "Content-Encoding"))
+                content_encoding = value;
+            else if (iequals(name, "Digest") || iequals(name, "Repr-Digest") ||
+                     iequals(name, "Content-Digest")) {
+                if (auto digest = parse_sha256_digest(value))
+                    expected_sha256 = *digest;
+            }
+        }
+
+        // Quick structural check: local file header at the start, and an EOCD
+        // record whose central directory fits before it.
+        void check_zip() const
+        {
+            if (size < eocd_size || std::memcmp(head.data(), "PK\x03\x04", 4))
+                throw verification_error{"not a zip archive"};
+
+            const std::size_t n = std::min(tail.size(), max_tail);
+            const char* base = tail.data() + tail.size() - n;
+
+            for (std::size_t pos = n - eocd_size + 1; pos-- > 0;) {
+                const char* eocd = base + pos;
+                if (std::memcmp(eocd, "PK\x05\x06", 4))
+                    continue;
+
+                const std::uint16_t comment_size = load_le16(eocd + 20);
+                if (pos + eocd_size + comment_size != n)
+                    continue;
+
+                const std::uint16_t entries = load_le16(eocd + 10);
+                const std::uint32_t cd_size = load_le32(eocd + 12);
+                const std::uint32_t cd_offset = load_le32(eocd + 16);
+
+                // ZIP64 archives store the real values elsewhere; accept them as is.
+                if (cd_size == 0xffffffff || cd_offset == 0xffffffff || entries == 0xffff)
+                    return;
+
+                const std::uint64_t eocd_offset = size - (n - pos);
+
+                if (!entries)
+                    throw verification_error{"zip archive has no entries"};
+
+                if (std::uint64_t{cd_offset} + cd_size > eocd_offset)
+                    throw verification_error{"zip central directory is truncated"};
+
+                return;
+            }
+
+            throw verification_error{"zip end of central directory not found"};
+        }
+    };
+
+    // Callbacks that must run on the UI thread, queued by the network thread.
+    using completion_queue = async_queue<std::move_only_function<void()>>;
+
     struct Download {
         std::shared_ptr<Info> info;
 
@@ -57,6 +277,15 @@ namespace DownloadManager {
         bool utheme_done = false;
         bool thumbnail_done = false;
 
+        unsigned utheme_attempts = 1;
+        StreamCheck utheme_check;
+
+        // ImageLoader's copy of the thumbnail, written out by start_thumbnail().
+        std::optional<std::vector<char>> thumbnail_data;
+
+        // The worker's copy of info->status; publish() makes it visible.
+        Status status;
+
         Download(Download&&) = delete;
 
         Download(std::shared_ptr<Info> info_,
@@ -67,16 +296,81 @@ namespace DownloadManager {
               failure_func{std::move(failure_func_)}
         {
             create_directories(info->utheme_output.parent_path());
-            create_directories(info->thumbnail_output.parent_path());
+
+            open_utheme_file();
+
+            setup_easy(utheme_easy, info->utheme_url, this, true);
+
+            curl_easy_setopt(utheme_easy, CURLOPT_HEADERDATA, this);
+            curl_easy_setopt(utheme_easy, CURLOPT_HEADERFUNCTION, utheme_header_callback);
+
+            // The thumbnail is usually on screen already; grab it before it's dropped.
+            thumbnail_data = ImageLoader::take_encoded(info->thumbnail_url);
+        }
+
+        // Runs on the worker thread. A missing thumbnail doesn't fail the download.
+        void start_thumbnail(CURLM* multi)
+        {
+            try {
+                create_directories(info->thumbnail_output.parent_path());
+
+                if (reuse_thumbnail()) {
+                    thumbnail_done = true;
+                    return;
+                }
+
+                if (!thumbnail_file.open(info->thumbnail_output, std::ios::out | std::ios::binary | std::ios::trunc))
+                    throw std::runtime_error{"could not open "s + info->thumbnail_output.string()};
+
+                setup_easy(thumbnail_easy, info->thumbnail_url, this, false);
+                curl_multi_add_handle(multi, thumbnail_easy);
+            }
+            catch (std::exception& e) {
+                cerr << "WARNING: DownloadManager: no thumbnail for " << info->label
+                     << ": " << e.what() << endl;
+                thumbnail_done = true;
+            }
+        }
+
+        // Avoid a second transfer: write out ImageLoader's copy of the thumbnail, or keep
+        // the file from an earlier download, unless that one is outdated.
+        bool reuse_thumbnail()
+        {
+            if (thumbnail_data) {
+                auto data = std::move(*thumbnail_data);
+                thumbnail_data.reset();
+
+                std::ofstream out{info->thumbnail_output, std::ios::binary | std::ios::trunc};
+                out.write(data.data(), data.size());
+                if (out.flush())
+                    return true;
+            }
+
+            // The file on the SD card is from the older version.
+            if (info->is_update)
+                return false;
+
+            std::error_code ec;
+            return std::filesystem::file_size(info->thumbnail_output, ec) > 0 && !ec;
+        }
+
+        void open_utheme_file()
+        {
+            if (utheme_file.is_open())
+                utheme_file.close();
 
             if (!utheme_file.open(info->utheme_output, std::ios::out | std::ios::binary | std::ios::trunc))
                 throw std::runtime_error{"could not open "s + info->utheme_output.string()};
 
-            if (!thumbnail_file.open(info->thumbnail_output, std::ios::out | std::ios::binary | std::ios::trunc))
-                throw std::runtime_error{"could not open "s + info->thumbnail_output.string()};
+            utheme_check.reset();
+            utheme_content_started = false;
+            status.progress = 0;
+            publish();
+        }
 
-            setup_easy(utheme_easy, info->utheme_url, this, true);
-            setup_easy(thumbnail_easy, info->thumbnail_url, this, false);
+        void publish() noexcept
+        {
+            info->status.store(status);
         }
 
         ~Download()
@@ -130,8 +424,32 @@ namespace DownloadManager {
             const size_t total = size * nmemb;
 
             self->utheme_content_started = true;
+            if (self->status.state == State::queued) {
+                self->status.state = State::in_progress;
+                self->publish();
+            }
+
+            auto written = self->utheme_file.sputn(ptr, total);
+            if (written > 0)
+                self->utheme_check.update(ptr, written);
 
-            return self->utheme_file.sputn(ptr, total);
+            return written;
+        }
+
+        static size_t utheme_header_callback(char* ptr, size_t size, size_t nmemb, void* userdata)
+        {
+            auto* self = static_cast<Download*>(userdata);
+            const size_t total = size * nmemb;
+
+            std::string_view line{ptr, total};
+
+            // A new response (after a redirect) starts over.
+            if (line.starts_with("HTTP/"))
+                self->utheme_check.reset();
+            else
+                self->utheme_check.header(line);
+
+            return total;
         }
 
         static size_t thumbnail_write_callback(char* ptr, size_t size, size_t nmemb, void* userdata)
@@ -153,14 +471,15 @@ namespace DownloadManager {
             auto* self = static_cast<Download*>(userdata);
 
             if (self->utheme_content_started && dltotal)
-                self->info->progress = float(dlnow) / float(dltotal);
+                self->status.progress = float(dlnow) / float(dltotal);
 
-            double speed = 0.0;
+            curl_off_t speed = 0;
 
-            if (self->utheme_easy)
+            if (self->utheme_easy && self->status.state != State::paused)
                 curl_easy_getinfo(self->utheme_easy, CURLINFO_SPEED_DOWNLOAD_T, &speed);
 
-            self->info->speed = static_cast<std::uint64_t>(speed);
+            self->status.speed = static_cast<std::uint64_t>(speed);
+            self->publish();
 
             return 0;
         }
@@ -183,48 +502,130 @@ namespace DownloadManager {
             return utheme_done && thumbnail_done;
         }
 
-        void finish()
+        // Called once the .utheme transfer completes; throws verification_error if the
+        // file can't be a valid archive, so the caller can retry it right away.
+        void verify_utheme()
+        {
+            if (utheme_file.pubsync() != 0)
+                throw std::runtime_error{"could not write "s + info->utheme_output.string()};
+
+            curl_off_t content_length = -1;
+            curl_easy_getinfo(utheme_easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+
+            curl_off_t received = 0;
+            curl_easy_getinfo(utheme_easy, CURLINFO_SIZE_DOWNLOAD_T, &received);
+
+            if (content_length >= 0 && received != content_length)
+                throw verification_error{"received " + std::to_string(received)
+                                         + " bytes, but Content-Length is "
+                                         + std::to_string(content_length)};
+
+            const bool identity = utheme_check.content_encoding.empty()
+                || iequals(utheme_check.content_encoding, "identity");
+
+            if (identity && content_length >= 0 &&
+                utheme_check.size != static_cast<std::uint64_t>(content_length))
+                throw verification_error{"wrote " + std::to_string(utheme_check.size)
+                                         + " bytes, but Content-Length is "
+                                         + std::to_string(content_length)};
+
+            auto digest = utheme_check.hasher.finish();
+
+            if (identity && utheme_check.expected_sha256 && digest != *utheme_check.expected_sha256)
+                throw verification_error{"SHA-256 mismatch: got " + sha256::to_hex(digest)
+                                         + ", expected "
+                                         + sha256::to_hex(*utheme_check.expected_sha256)};
+
+            utheme_check.check_zip();
+
+            info->crc32 = utheme_check.crc;
+            info->sha256 = sha256::to_hex(digest);
+        }
+
+        void finish(completion_queue& completions)
         {
             utheme_file.close();
             thumbnail_file.close();
 
+            // The file may have replaced one that's already loaded.
+            ImageLoader::forget(info->thumbnail_output.string());
+
+            status.progress = 1;
+            status.speed = 0;
+            status.state = State::finished;
+            publish();
+
+            cout << "Finished download: " << info->utheme_output
+                 << "\n    CRC32: " << std::hex << info->crc32 << std::dec
+                 << "\n    SHA-256: " << info->sha256
+                 << endl;
+
             if (success_func)
-                success_func(*info);
+                completions.push([func = std::move(success_func), info = info] mutable
+                {
+                    func(*info);
+                });
         }
 
-        void finish(const std::exception& e) noexcept
+        void finish(completion_queue& completions,
+                    const std::exception& e,
+                    State final_state = State::failed) noexcept
         try {
             utheme_file.close();
             thumbnail_file.close();
 
-            if (failure_func)
-                failure_func(e);
+            status.speed = 0;
+            status.state = final_state;
+            publish();
+
+            // Don't leave a broken archive behind for the local themes list.
+            std::error_code ec;
+            std::filesystem::remove(info->utheme_output, ec);
+
+            completions.push([func = std::move(failure_func),
+                              info = info,
+                              error = std::runtime_error{e.what()}] mutable
+            {
+                info->error = error.what();
+                if (func)
+                    func(error);
+            });
         }
         catch (...) {
         }
     };
 
     struct Resources {
-        CURLM* multi = nullptr;
-
+        // Only accessed from the UI thread.
         std::vector<std::shared_ptr<const Info>> infos;
+
+        // Only accessed from the worker thread.
         std::list<Download> downloads;
+        CURLM* multi = nullptr;
+
+        completion_queue completions;
+
+        curl_worker worker;
 
         Resources()
         {
             TRACE_FUNC;
 
-            multi = curl_multi_init();
-            if (!multi)
-                throw std::runtime_error{"curl_multi_init() failed"};
+            multi = worker.get_multi();
+
+            // NOTE: a whole page of themes may be queued at once, so allow a few
+            // transfers per host to run in parallel.
+            curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 8L);
+            curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, 8L);
+            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, 4L);
 
-            curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 5L);
-            curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, 5L);
-            curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, 1L);
+            worker.start([this](CURLMsg* msg) { on_done(msg); });
         }
 
         ~Resources() noexcept
         {
+            worker.stop();
+
             for (auto& d : downloads) {
                 if (d.utheme_easy)
                     curl_multi_remove_handle(multi, d.utheme_easy);
@@ -233,75 +634,209 @@ namespace DownloadManager {
                     curl_multi_remove_handle(multi, d.thumbnail_easy);
             }
 
-            if (multi) {
-                curl_multi_cleanup(multi);
-                multi = nullptr;
-            }
         }
 
-        void process()
+        // Runs on the worker thread.
+        Download* find_download(const std::string& url)
         {
-            int running = 0;
-            curl_multi_perform(multi, &running);
+            auto it = std::ranges::find_if(downloads,
+                                           [&url](const Download& d)
+                                           {
+                                               return d.info->utheme_url == url;
+                                           });
+            if (it == downloads.end())
+                return nullptr;
+            return &*it;
+        }
 
-            int msgs_left = 0;
-            while (auto* msg = curl_multi_info_read(multi, &msgs_left)) {
-                if (msg->msg != CURLMSG_DONE)
-                    continue;
+        // Runs on the worker thread.
+        void remove_download(Download& d)
+        {
+            if (d.utheme_easy)
+                curl_multi_remove_handle(multi, d.utheme_easy);
 
-                CURL* completed_easy = msg->easy_handle;
+            if (d.thumbnail_easy)
+                curl_multi_remove_handle(multi, d.thumbnail_easy);
 
-                auto completed = std::ranges::find_if(
-                    downloads,
-                    [completed_easy](const Download& d) {
-                        return d.owns(completed_easy);
-                    }
-                );
+            std::erase_if(downloads, [&d](const Download& x) { return &x == &d; });
+        }
 
-                try {
-                    if (completed == downloads.end())
-                        throw std::logic_error{"BUG: transfer not found"};
+        // Runs on the worker thread.
+        void pause(Download& d)
+        {
+            if (d.status.state != State::queued && d.status.state != State::in_progress)
+                return;
+
+            curl_easy_pause(d.utheme_easy, CURLPAUSE_ALL);
+
+            d.status.state = State::paused;
+            d.status.speed = 0;
+            d.publish();
+        }
+
+        // Runs on the worker thread.
+        void resume(Download& d)
+        {
+            if (d.status.state != State::paused)
+                return;
 
-                    if (msg->data.result != CURLE_OK) {
-                        throw std::runtime_error{
-                            curl_easy_strerror(msg->data.result)
-                        };
-                    }
+            d.status.state = d.utheme_content_started ? State::in_progress : State::queued;
+            d.publish();
 
-                    completed->mark_done(completed_easy);
+            curl_easy_pause(d.utheme_easy, CURLPAUSE_CONT);
+        }
+
+        // Runs on the worker thread.
+        void cancel(Download& d)
+        {
+            d.finish(completions, std::runtime_error{"Canceled."}, State::canceled);
+            remove_download(d);
+        }
+
+        // Post action(download) to the worker thread; url == "" means all downloads.
+        void post_action(const std::string& url, void (Resources::*action)(Download&))
+        {
+            worker.post([this, url, action]
+            {
+                if (url.empty()) {
+                    // NOTE: cancel() removes the node, so don't iterate over the list.
+                    std::vector<Download*> targets;
+                    for (auto& d : downloads)
+                        targets.push_back(&d);
+                    for (auto* d : targets)
+                        (this->*action)(*d);
                 }
-                catch (std::exception& e) {
-                    cerr << "DownloadManager::Resources::process(): ERROR: "
-                         << e.what()
-                         << endl;
+                else if (auto* d = find_download(url)) {
+                    (this->*action)(*d);
+                }
+            });
+        }
 
-                    if (completed != downloads.end())
-                        completed->finish(e);
+        void clear_finished()
+        {
+            std::erase_if(infos,
+                          [](const std::shared_ptr<const Info>& info)
+                          {
+                              return !is_active(info->status.load().state);
+                          });
+        }
 
-                    if (completed != downloads.end()) {
-                        if (completed->utheme_easy)
-                            curl_multi_remove_handle(multi, completed->utheme_easy);
+        // Starts the .utheme transfer over, if the error is worth retrying.
+        bool retry_utheme(Download& d, const std::exception& e)
+        {
+            if (d.utheme_attempts >= max_attempts)
+                return false;
 
-                        if (completed->thumbnail_easy)
-                            curl_multi_remove_handle(multi, completed->thumbnail_easy);
+            ++d.utheme_attempts;
 
-                        downloads.erase(completed);
-                    }
+            cerr << "DownloadManager: retrying " << d.info->utheme_url
+                 << " (attempt " << d.utheme_attempts << "/" << max_attempts << "): "
+                 << e.what()
+                 << endl;
 
-                    continue;
+            curl_multi_remove_handle(multi, d.utheme_easy);
+            d.open_utheme_file();
+            curl_multi_add_handle(multi, d.utheme_easy);
+
+            return true;
+        }
+
+        static bool is_transient(CURL* easy, CURLcode code)
+        {
+            switch (code) {
+                case CURLE_COULDNT_RESOLVE_HOST:
+                case CURLE_COULDNT_CONNECT:
+                case CURLE_OPERATION_TIMEDOUT:
+                case CURLE_PARTIAL_FILE:
+                case CURLE_GOT_NOTHING:
+                case CURLE_SEND_ERROR:
+                case CURLE_RECV_ERROR:
+                case CURLE_SSL_CONNECT_ERROR:
+                case CURLE_BAD_CONTENT_ENCODING:
+                    return true;
+
+                case CURLE_HTTP_RETURNED_ERROR: {
+                    long status = 0;
+                    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+                    return status >= 500 || status == 408 || status == 429;
                 }
 
+                default:
+                    return false;
+            }
+        }
+
+        // Runs on the worker thread.
+        void on_done(CURLMsg* msg)
+        {
+            CURL* completed_easy = msg->easy_handle;
+            CURLcode result = msg->data.result;
+
+            auto completed = std::ranges::find_if(
+                downloads,
+                [completed_easy](const Download& d) {
+                    return d.owns(completed_easy);
+                }
+            );
+
+            try {
+                if (completed == downloads.end())
+                    throw std::logic_error{"BUG: transfer not found"};
+
+                const bool is_utheme = completed_easy == completed->utheme_easy;
+
+                try {
+                    if (result != CURLE_OK)
+                        throw std::runtime_error{curl_easy_strerror(result)};
+
+                    if (is_utheme)
+                        completed->verify_utheme();
+                }
+                catch (std::exception& e) {
+                    const bool retryable = dynamic_cast<verification_error*>(&e)
+                        || is_transient(completed_easy, result);
+                    if (is_utheme && retryable && retry_utheme(*completed, e))
+                        return;
+                    throw;
+                }
+
+                completed->mark_done(completed_easy);
+            }
+            catch (std::exception& e) {
+                cerr << "DownloadManager::Resources::on_done(): ERROR: "
+                     << e.what()
+                     << endl;
+
                 if (completed != downloads.end()) {
-                    curl_multi_remove_handle(multi, completed_easy);
+                    completed->finish(completions, e);
+                    remove_download(*completed);
+                }
 
-                    if (completed->is_done()) {
-                        completed->finish();
-                        downloads.erase(completed);
-                    }
+                return;
+            }
+
+            if (completed != downloads.end()) {
+                curl_multi_remove_handle(multi, completed_easy);
+
+                if (completed->is_done()) {
+                    completed->finish(completions);
+                    downloads.erase(completed);
                 }
             }
         }
 
+        // Runs on the UI thread.
+        void process()
+        {
+            for (;;) {
+                auto completion = completions.try_pop();
+                if (!completion)
+                    break;
+
+                (*completion)();
+            }
+        }
+
         const std::vector<std::shared_ptr<const Info>>& get_infos() const
         {
             return infos;
@@ -313,8 +848,18 @@ namespace DownloadManager {
                  const std::filesystem::path& utheme_output,
                  const std::filesystem::path& thumbnail_output,
                  success_function_t success_func,
-                 failure_function_t failure_func)
+                 failure_function_t failure_func,
+                 bool is_update)
         {
+            // A download that failed or was canceled can be added again.
+            std::erase_if(infos,
+                          [&utheme_url](const std::shared_ptr<const Info>& entry)
+                          {
+                              auto state = entry->status.load().state;
+                              return entry->utheme_url == utheme_url
+                                  && (state == State::failed || state == State::canceled);
+                          });
+
             for (auto& entry : infos) {
                 if (entry->utheme_url == utheme_url)
                     return false;
@@ -323,29 +868,34 @@ namespace DownloadManager {
             auto sanitized_utheme_output = sanitize(utheme_output);
             auto sanitized_thumbnail_output = sanitize(thumbnail_output);
 
-            auto info = std::make_shared<Info>(
-                label,
-                utheme_url,
-                thumbnail_url,
-                sanitized_utheme_output,
-                sanitized_thumbnail_output,
-                0.0f,
-                0,
-                State::queued
-            );
-
-            infos.push_back(info);
-
-            downloads.emplace_back(
-                std::move(info),
+            auto info = std::make_shared<Info>();
+            info->label = label;
+            info->utheme_url = utheme_url;
+            info->thumbnail_url = thumbnail_url;
+            info->utheme_output = std::move(sanitized_utheme_output);
+            info->thumbnail_output = std::move(sanitized_thumbnail_output);
+            info->is_update = is_update;
+
+            // NOTE: construct it here, so errors opening the files are reported to the
+            // caller; then hand the node over to the worker thread.
+            std::list<Download> pending;
+            pending.emplace_back(
+                info,
                 std::move(success_func),
                 std::move(failure_func)
             );
 
-            auto& download = downloads.back();
+            infos.push_back(std::move(info));
 
-            curl_multi_add_handle(multi, download.utheme_easy);
-            curl_multi_add_handle(multi, download.thumbnail_easy);
+            worker.post([this, pending = std::move(pending)] mutable
+            {
+                auto& download = pending.front();
+
+                curl_multi_add_handle(multi, download.utheme_easy);
+                download.start_thumbnail(multi);
+
+                downloads.splice(downloads.end(), pending);
+            });
 
             cout << "Added download:"
                  << "\n    " << label
@@ -387,24 +937,46 @@ namespace DownloadManager {
             res->process();
     }
 
+    bool is_active(State state) noexcept
+    {
+        switch (state) {
+            case State::queued:
+            case State::in_progress:
+            case State::paused:
+                return true;
+            default:
+                return false;
+        }
+    }
+
     void pause_all()
     {
         TRACE_FUNC;
+        assert(res);
+
+        res->post_action("", &Resources::pause);
     }
 
     void resume_all()
     {
         TRACE_FUNC;
+        assert(res);
+
+        res->post_action("", &Resources::resume);
     }
 
     void cancel_all()
     {
         TRACE_FUNC;
+        assert(res);
+
+        res->post_action("", &Resources::cancel);
     }
 
     void clear_finished()
     {
-        res->infos.clear();
+        assert(res);
+        res->clear_finished();
     }
 
     bool add(const std::string& label,
@@ -413,7 +985,8 @@ namespace DownloadManager {
              const std::filesystem::path& utheme_output,
              const std::filesystem::path& thumbnail_output,
              success_function_t success_func,
-             failure_function_t failure_func)
+             failure_function_t failure_func,
+             bool is_update)
     {
         TRACE_FUNC;
         assert(res);
@@ -425,7 +998,8 @@ namespace DownloadManager {
             utheme_output,
             thumbnail_output,
             std::move(success_func),
-            std::move(failure_func)
+            std::move(failure_func),
+            is_update
         );
     }
 
@@ -435,6 +1009,16 @@ namespace DownloadManager {
         assert(res);
 
         cout << "Pausing " << url << endl;
+        res->post_action(url, &Resources::pause);
+    }
+
+    void resume(const std::string& url)
+    {
+        TRACE_FUNC;
+        assert(res);
+
+        cout << "Resuming " << url << endl;
+        res->post_action(url, &Resources::resume);
     }
 
     void cancel(const std::string& url)
@@ -443,6 +1027,7 @@ namespace DownloadManager {
         assert(res);
 
         cout << "Canceling " << url << endl;
+        res->post_action(url, &Resources::cancel);
     }
 
     const std::vector<std::shared_ptr<const Info>>& get_infos()
@@ -17,6 +17,8 @@
 #include <string>
 #include <vector>
 
+#include "seqlock.hpp"
+
 namespace DownloadManager {
 
     enum class State {
@@ -25,6 +27,13 @@ namespace DownloadManager {
         finished,
         paused,
         canceled,
+        failed,
+    };
+
+    struct Status {
+        State state = State::queued;
+        float progress = 0;
+        std::uint64_t speed = 0;
     };
 
     struct Info {
@@ -34,13 +43,28 @@ namespace DownloadManager {
         std::string thumbnail_url;
         std::filesystem::path utheme_output;
         std::filesystem::path thumbnail_output;
-        float progress = 0;
-        std::uint64_t speed = 0;
-        State state;
+
+        // Written from the network thread; take a snapshot with status.load().
+        seqlock<Status> status;
+
+        // A new version of an installed theme; the caller installs it, not the user.
+        bool is_update = false;
+
+        // Filled in once the .utheme passes verification.
+        std::uint32_t crc32 = 0;
+        std::string sha256;
+
+        // Set when the failure is reported, on the UI thread.
+        std::string error;
 
     }; // struct Info
 
 
+    bool
+    is_active(State state)
+        noexcept;
+
+
     using success_function_sig = void (const Info& info);
     using failure_function_sig = void (const std::exception& error);
 
@@ -54,6 +78,8 @@ namespace DownloadManager {
     void
     finalize();
 
+    /// Call this once per frame: it runs the success and failure callbacks of
+    /// finished downloads. The transfers themselves run on a network thread.
     void
     process();
 
@@ -67,10 +93,14 @@ namespace DownloadManager {
     void
     cancel_all();
 
+    /// Forgets the downloads that are no longer active.
     void
     clear_finished();
 
 
+    /// The thumbnail is taken from ImageLoader, or from an earlier download, when it
+    /// can. An update is a new version of an installed theme, installed by the caller:
+    /// it always gets a fresh thumbnail.
     bool
     add(const std::string& label,
         const std::string& utheme_url,
@@ -78,11 +108,15 @@ namespace DownloadManager {
         const std::filesystem::path& utheme_output,
         const std::filesystem::path& thumbnail_output,
         success_function_t success_func,
-        failure_function_t failure_func);
+        failure_function_t failure_func,
+        bool is_update = false);
 
     void
     pause(const std::string& url);
 
+    void
+    resume(const std::string& url);
+
     void
     cancel(const std::string& url);
 
@@ -8,21 +8,24 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
+#include <cctype>
 #include <chrono>
 #include <cmath>
-#include <concepts>
 #include <filesystem>
 #include <functional>
 #include <iostream>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <optional>
 #include <print>
-#include <queue>
 #include <ranges>
 #include <span>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 
@@ -36,8 +39,13 @@
 
 #include "App.h"
 #include "async_queue.hpp"
+#include "buffer_pool.hpp"
+#include "curl_worker.hpp"
+#include "disk_cache.hpp"
+#include "pixel_sidecar.hpp"
 #include "thread_safe.hpp"
 #include "tracer.hpp"
+#include "utils.h"
 
 using std::cout;
 using std::cerr;
@@ -49,11 +57,21 @@ namespace ImageLoader {
 
     std::filesystem::path content_prefix = "fs:/vol/content";
 
-    const std::size_t max_cache_size = 64;
+    // Budget for decoded pixels, in surfaces, textures and atlas pages. Entries drawn in
+    // the current or previous frame are never evicted, so this can be exceeded for a moment.
+    std::atomic<std::size_t> max_cache_bytes = 48 * 1024 * 1024;
+    std::atomic<std::size_t> cache_bytes = 0;
+    // The part of the atlas pages not taken by the entries in them, which count their own
+    // bytes; a page is only freed once it's empty, so this is spent too.
+    std::atomic<std::size_t> atlas_slack_bytes = 0;
+    // Bounds the bookkeeping for entries that hold no pixels (errors.)
+    const std::size_t max_cache_entries = 256;
 
-    std::uint64_t use_counter = 0;
+    std::atomic<std::uint64_t> current_frame = 0;
 
     SDL_Renderer *renderer = nullptr;
+    // Decoders convert to this, so uploading textures is a plain copy.
+    Uint32 native_format = SDL_PIXELFORMAT_ARGB8888;
     SDL_Texture *load_error_image = nullptr;
     SDL_Texture *loading_image = nullptr;
 
@@ -63,47 +81,354 @@ namespace ImageLoader {
         unloaded,
         requested,
         loading,
+        decoding,
         loaded,
         error,
     };
 
     std::string to_string(LoadState st);
 
-    struct CacheEntry {
+    // Thumbnails of the same size are packed into a few big textures, so a page of theme
+    // cards doesn't switch textures for every card. Only the UI thread touches these.
+    struct AtlasSlot {
+        int page = -1;
+        int index = -1;
+        // The entry's bytes, taken out of atlas_slack_bytes.
+        std::size_t bytes = 0;
+    };
+
+    struct AtlasPage {
+        SDL_Texture *texture = nullptr;
+        std::vector<bool> used;
+        unsigned used_count = 0;
+    };
+
+    struct Atlas {
+        int slot_width;
+        int slot_height;
+        std::vector<AtlasPage> pages;
+    };
+
+    // Uploads in a single frame are limited, so a burst of finished images doesn't cause
+    // a stutter; at least one upload always happens. Only images being drawn are uploaded,
+    // so those on screen go first.
+    const unsigned max_uploads_per_frame = 4;
+    const std::size_t max_upload_bytes_per_frame = 4 * 1024 * 1024;
+
+    UploadStats upload_stats;
+    UploadStats last_upload_stats;
+
+    const int atlas_page_width = 2048;
+    const int atlas_page_height = 1024;
+    const std::size_t max_atlas_pages = 4;
+
+    static std::size_t atlas_page_bytes()
+    {
+        return std::size_t(atlas_page_width) * atlas_page_height * SDL_BYTESPERPIXEL(native_format);
+    }
+
+    std::array<Atlas, 2> atlases{{
+        {426, 240, {}},
+        {320, 180, {}},
+    }};
+
+    struct CacheEntry;
+
+    // One HTTP request for a CacheEntry.
+    struct Transfer {
+        CacheEntry *entry = nullptr;
+        CURL *easy = nullptr;
+        curl_slist *headers = nullptr;
+        std::vector<char> body;
+        // Caching headers of the response being received.
+        disk_cache::metadata response;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    // The state says which thread owns the other members:
+    //   - requested: handed from the UI thread to the network worker
+    //   - loading: the network worker
+    //   - decoding: a decoder thread
+    //   - loaded, error: the UI thread
+    struct CacheEntry : std::enable_shared_from_this<CacheEntry> {
         std::atomic<LoadState> state{LoadState::unloaded};
-        std::uint64_t last_use = 0;
+        std::atomic<std::uint64_t> last_frame = 0;
+        // Last frame prefetch() asked for it.
+        std::atomic<std::uint64_t> prefetch_frame = 0;
+        // CLOCK reference bit.
+        std::atomic<bool> referenced = false;
 
         SDL_Surface *img = nullptr;
         SDL_Texture *tex = nullptr;
+        // Counted in cache_bytes.
+        std::size_t bytes = 0;
 
-        CURL *easy = nullptr;
-        curl_slist *headers = nullptr;
+        // Key in the cache: the location, plus the size it's drawn at, if any.
+        std::string key;
+        // Decode-time downscaling target; 0 means full size.
+        int max_width = 0;
+        int max_height = 0;
+
+        // A local file that doesn't exist; drawn as the placeholder, not as an error.
+        bool missing = false;
+
+        // If set, the pixels go into an atlas page instead of tex; UI thread only.
+        bool use_atlas = false;
+        int atlas = -1;
+        AtlasSlot atlas_slot;
+        ImVec2 uv0{0, 0};
+        ImVec2 uv1{1, 1};
+
+        // The requests in flight; a second one is sent if the first is slow to respond.
+        std::vector<std::unique_ptr<Transfer>> transfers;
 
         std::optional<std::vector<char>> raw_buf;
         std::string location;
+
+        // What the disk cache has for this location, if we're revalidating it.
+        std::optional<disk_cache::metadata> cached;
+
+        // Failed attempts in a row; an entry in the error state is retried from retry_at.
+        unsigned failures = 0;
+        std::chrono::steady_clock::time_point retry_at;
+
+        // Set by forget() when it had to leave the entry to whoever still holds it.
+        std::atomic<bool> forgotten = false;
+
+        // Normally retired already; a forgotten entry is freed by its last holder.
+        ~CacheEntry();
     };
 
-    using cache_t = std::unordered_map<std::string, CacheEntry>;
-    thread_safe<cache_t> safe_cache;
+    using cache_t = std::unordered_map<std::string, std::shared_ptr<CacheEntry>>;
 
-    async_queue<std::string> requests_queue;
-    std::jthread worker_thread;
+    // Sharded, so the UI thread rarely waits on a worker; the locks only protect the
+    // maps, never decoding or transfers.
+    const std::size_t num_shards = 8;
+    std::array<thread_safe<cache_t>, num_shards> shards;
 
-    static void destroy_entry(CacheEntry& entry)
+    thread_safe<cache_t>& shard_for(const std::string& location)
     {
-        if (multi && entry.easy)
-            curl_multi_remove_handle(multi, entry.easy);
+        return shards[std::hash<std::string>{}(location) % num_shards];
+    }
+
+    std::shared_ptr<CacheEntry> find_entry(const std::string& location)
+    {
+        auto cache = shard_for(location).lock();
+        auto it = cache->find(location);
+        if (it == cache->end())
+            return {};
+        return it->second;
+    }
+
+    // Eviction order: a CLOCK over all entries. Lock this before any shard.
+    struct Clock {
+        std::list<CacheEntry*> ring;
+        std::list<CacheEntry*>::iterator hand = ring.end();
+    };
+    thread_safe<Clock> safe_clock;
+
+    // Textures and atlas slots can only be released on the UI thread, in new_frame().
+    struct Retired {
+        std::vector<SDL_Texture*> textures;
+        std::vector<std::pair<int, AtlasSlot>> atlas_slots;
+    };
+    thread_safe<Retired> safe_retired;
+
+    // What a Handle refers to; only the UI thread touches these.
+    struct HandleSlot {
+        std::string location;
+        float width = 0;
+        float height = 0;
+        // Bumped when the slot is released, so stale handles are caught.
+        std::uint32_t generation = 1;
+        bool in_use = false;
+        // Held while the image is drawn, so it can be found without a lookup; dropped in
+        // new_frame() once it's not, so the entry can be evicted again.
+        std::shared_ptr<CacheEntry> entry;
+    };
+    std::vector<HandleSlot> handle_slots;
+    std::vector<std::uint32_t> free_handle_slots;
+
+    // Decoding happens here, outside of any lock.
+    const unsigned num_decoders = 2;
+    async_queue<std::shared_ptr<CacheEntry>> decode_queue;
+    std::vector<std::jthread> decoders;
+
+    // Drives the transfers; requests from get() are posted to it.
+    std::optional<curl_worker> worker;
+
+    // Requests are started by priority, not in the order they came in. A request whose
+    // image wasn't drawn or prefetched for a while is dropped, even if already in flight.
+    enum class Priority : int {
+        visible,
+        prefetch,
+        background,
+    };
 
-        if (entry.headers) {
-            curl_slist_free_all(entry.headers);
-            entry.headers = nullptr;
+    // In frames.
+    const std::uint64_t prefetch_lifetime = 10 * 60;
+    const std::uint64_t background_lifetime = 2 * 60;
+
+    const std::size_t max_transfers = 6;
+
+    // A transfer slower than low_speed_limit bytes per second, for low_speed_time
+    // seconds, is given up on.
+    const long low_speed_limit = 1024;
+    const long low_speed_time = 10;
+    const long connect_timeout_ms = 10'000;
+    // A visible image that got no data for this long gets a second request, and
+    // whichever finishes first is used.
+    const std::chrono::milliseconds hedge_after{2500};
+
+    // Failures are retried after a delay that doubles each time; errors that won't
+    // go away by themselves (like a 404) use the longest delay.
+    const std::chrono::seconds min_retry_delay{2};
+    const std::chrono::seconds max_retry_delay{5 * 60};
+
+    // Only touched by the worker thread.
+    std::vector<std::shared_ptr<CacheEntry>> pending_requests;
+    std::vector<std::shared_ptr<CacheEntry>> active_transfers;
+
+    // Requests waiting or in flight; while not zero, new_frame() keeps rescheduling.
+    std::atomic<std::size_t> outstanding_requests = 0;
+
+    // Moving average of the download speed, in bytes per second; 0 until measured.
+    // Smaller transfers are mostly latency, so they're not counted.
+    std::atomic<double> bandwidth = 0;
+    const curl_off_t min_bandwidth_sample = 16 * 1024;
+    // A larger variant is only fetched if it's expected to arrive within this time.
+    const double max_variant_seconds = 1.5;
+
+    // Network images survive restarts here, so pages already seen work offline.
+    const std::uint64_t max_disk_cache_bytes = 32 * 1024 * 1024;
+    // Used when the server doesn't say how long a response stays fresh.
+    const std::int64_t default_max_age = 24 * 60 * 60;
+    std::optional<disk_cache> disk;
+
+    // Encoded bytes of the most recent network images, so other modules can reuse them
+    // without downloading them again. Most recently used at the front.
+    const std::size_t max_encoded_bytes = 1024 * 1024;
+    const std::size_t max_encoded_entry_bytes = 256 * 1024;
+
+    // Bodies of transfers, and encoded images read from the disk cache.
+    buffer_pool<std::vector<char>> buffers;
+    // Theme screenshots are well under this; anything larger is aborted.
+    const std::size_t max_image_bytes = 16 * 1024 * 1024;
+
+    static void release_raw_buf(CacheEntry& entry)
+    {
+        if (entry.raw_buf) {
+            buffers.release(std::move(*entry.raw_buf));
+            entry.raw_buf.reset();
         }
+    }
+
+    struct EncodedEntry {
+        std::string location;
+        std::vector<char> data;
+    };
+
+    struct EncodedCache {
+        std::list<EncodedEntry> entries;
+        std::size_t total_bytes = 0;
+    };
+    thread_safe<EncodedCache> safe_encoded;
 
-        if (entry.easy) {
-            curl_easy_cleanup(entry.easy);
-            entry.easy = nullptr;
+    static void remember_encoded(const std::string& location, std::vector<char> data)
+    {
+        if (data.size() > max_encoded_entry_bytes) {
+            buffers.release(std::move(data));
+            return;
         }
 
+        auto encoded = safe_encoded.lock();
+
+        std::erase_if(encoded->entries,
+                      [&](const EncodedEntry& e)
+                      {
+                          if (e.location != location)
+                              return false;
+                          encoded->total_bytes -= e.data.size();
+                          return true;
+                      });
+
+        encoded->total_bytes += data.size();
+        encoded->entries.emplace_front(location, std::move(data));
+
+        while (encoded->total_bytes > max_encoded_bytes) {
+            encoded->total_bytes -= encoded->entries.back().data.size();
+            buffers.release(std::move(encoded->entries.back().data));
+            encoded->entries.pop_back();
+        }
+    }
+
+    // Frees the pixels of an evicted entry; the texture is only queued for destruction.
+    static void retire_entry(CacheEntry& entry)
+    {
+        if (entry.tex || entry.atlas >= 0) {
+            auto retired = safe_retired.lock();
+            if (entry.tex)
+                retired->textures.push_back(entry.tex);
+            if (entry.atlas >= 0)
+                retired->atlas_slots.emplace_back(entry.atlas, entry.atlas_slot);
+            entry.tex = nullptr;
+            entry.atlas = -1;
+        }
+
+        if (entry.img) {
+            SDL_FreeSurface(entry.img);
+            entry.img = nullptr;
+        }
+
+        cache_bytes -= entry.bytes;
+        entry.bytes = 0;
+    }
+
+    CacheEntry::~CacheEntry()
+    {
+        retire_entry(*this);
+    }
+
+    static void free_transfer(Transfer& transfer)
+    {
+        if (transfer.easy) {
+            if (multi)
+                curl_multi_remove_handle(multi, transfer.easy);
+            curl_easy_cleanup(transfer.easy);
+            transfer.easy = nullptr;
+        }
+
+        if (transfer.headers) {
+            curl_slist_free_all(transfer.headers);
+            transfer.headers = nullptr;
+        }
+
+        buffers.release(std::move(transfer.body));
+    }
+
+    static void free_transfers(CacheEntry& entry)
+    {
+        for (auto& transfer : entry.transfers)
+            free_transfer(*transfer);
+        entry.transfers.clear();
+    }
+
+    static void mark_failed(CacheEntry& entry, bool transient = true)
+    {
+        auto delay = max_retry_delay;
+        if (transient)
+            delay = std::min<std::chrono::seconds>(min_retry_delay * (1u << std::min(entry.failures, 8u)),
+                                                   max_retry_delay);
+
+        ++entry.failures;
+        entry.retry_at = std::chrono::steady_clock::now() + delay;
+        entry.state = LoadState::error;
+    }
+
+    static void destroy_entry(CacheEntry& entry)
+    {
+        free_transfers(entry);
+
         if (entry.tex) {
             SDL_DestroyTexture(entry.tex);
             entry.tex = nullptr;
@@ -114,23 +439,113 @@ namespace ImageLoader {
             entry.img = nullptr;
         }
 
-        entry.raw_buf.reset();
+        release_raw_buf(entry);
     }
 
+    // Returning less than total makes curl abort the transfer.
     static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+    try {
+        auto* transfer = static_cast<Transfer*>(userdata);
+        const std::size_t total = size * nmemb;
+        auto& body = transfer->body;
+
+        if (body.size() + total > max_image_bytes)
+            return 0;
+
+        // Size the buffer from the headers, so it doesn't grow chunk by chunk; but don't
+        // trust it with more than a pooled buffer.
+        if (body.capacity() == 0) {
+            curl_off_t length = -1;
+            curl_easy_getinfo(transfer->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+            const std::size_t expected = length > 0
+                ? std::min<std::size_t>(length, buffer_pool<std::vector<char>>::max_pooled_size)
+                : 0;
+            buffers.reserve(body, std::max(total, expected));
+        }
+
+        // No Content-Length, or it was for the compressed body.
+        if (body.size() + total > body.capacity())
+            buffers.reserve(body,
+                            std::min(std::max(body.size() + total, 2 * body.capacity()),
+                                     max_image_bytes));
+
+        body.insert(body.end(), ptr, ptr + total);
+
+        return total;
+    }
+    catch (...) {
+        // Exceptions can't go through curl.
+        return 0;
+    }
+
+    static std::string_view trim(std::string_view s)
     {
-        auto* entry = static_cast<CacheEntry*>(userdata);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    static bool starts_with_nocase(std::string_view s, std::string_view prefix)
+    {
+        return s.size() >= prefix.size()
+            && std::ranges::equal(s.substr(0, prefix.size()),
+                                  prefix,
+                                  {},
+                                  [](char c) { return std::tolower(static_cast<unsigned char>(c)); },
+                                  [](char c) { return std::tolower(static_cast<unsigned char>(c)); });
+    }
+
+    static size_t header_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+    {
+        auto* transfer = static_cast<Transfer*>(userdata);
         const std::size_t total = size * nmemb;
 
-        if (!entry->raw_buf)
-            entry->raw_buf.emplace();
+        std::string_view line{ptr, total};
 
-        entry->raw_buf->insert(entry->raw_buf->end(), ptr, ptr + total);
+        if (line.starts_with("HTTP/")) {
+            // A new response (after a redirect) starts over.
+            transfer->response = {};
+            transfer->response.max_age = default_max_age;
+        }
+        else if (starts_with_nocase(line, "etag:")) {
+            transfer->response.etag = trim(line.substr(5));
+        }
+        else if (starts_with_nocase(line, "last-modified:")) {
+            transfer->response.last_modified = trim(line.substr(14));
+        }
+        else if (starts_with_nocase(line, "cache-control:")) {
+            auto value = trim(line.substr(14));
+            if (value.find("no-store") != value.npos) {
+                transfer->response.max_age = -1;
+            }
+            else if (value.find("no-cache") != value.npos) {
+                transfer->response.max_age = 0;
+            }
+            else if (auto pos = value.find("max-age="); pos != value.npos) {
+                try {
+                    transfer->response.max_age = std::stoll(std::string{value.substr(pos + 8)});
+                }
+                catch (std::exception&) {
+                }
+            }
+        }
 
         return total;
     }
 
-    void worker_func(std::stop_token token);
+    bool process_one_request(CacheEntry& entry);
+    void schedule_requests();
+    void decode_entry(CacheEntry& entry);
+    void decoder_func();
+    void handle_finished_download(CURLMsg* msg);
+    void trim_cache();
+
+    static bool is_over_budget()
+    {
+        return cache_bytes + atlas_slack_bytes > max_cache_bytes;
+    }
 
     void initialize(SDL_Renderer* rend)
     {
@@ -138,6 +553,18 @@ namespace ImageLoader {
 
         renderer = rend;
 
+        SDL_RendererInfo info;
+        if (SDL_GetRendererInfo(renderer, &info) == 0) {
+            for (Uint32 i = 0; i < info.num_texture_formats; ++i) {
+                const Uint32 format = info.texture_formats[i];
+                if (!SDL_ISPIXELFORMAT_FOURCC(format) && SDL_ISPIXELFORMAT_ALPHA(format)) {
+                    native_format = format;
+                    break;
+                }
+            }
+        }
+        cout << "ImageLoader: texture format is " << SDL_GetPixelFormatName(native_format) << endl;
+
         loading_image = IMG_LoadTexture(
             renderer,
             "fs:/vol/content/ui/theme-placeholder-icon.png");
@@ -152,33 +579,89 @@ namespace ImageLoader {
         if (load_error_image)
             SDL_SetTextureBlendMode(load_error_image, SDL_BLENDMODE_BLEND);
 
-        requests_queue.reset();
+        try {
+            disk.emplace(THEMIIFY_HTTP_CACHE / "images", max_disk_cache_bytes);
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ImageLoader::initialize(): disk cache disabled: " << e.what() << endl;
+        }
+
+        decode_queue.reset();
+        for (unsigned i = 0; i < num_decoders; ++i)
+            decoders.emplace_back(decoder_func);
 
         cout << "ImageLoader: launching worker thread." << endl;
-        worker_thread = std::jthread{worker_func};
+        worker.emplace();
+        multi = worker->get_multi();
+
+        curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, 10L);
+        curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 10L);
+
+        worker->start([](CURLMsg* msg)
+        {
+            handle_finished_download(msg);
+        });
 
         assert((std::atomic<LoadState>{}.is_lock_free()));
     }
 
     void finalize()
     {
-        cout << "Stopping requests_queue" << endl;
-        requests_queue.stop();
+        cout << "Stopping worker thread" << endl;
+        if (worker)
+            worker->stop();
+        cout << "Worker thread stopped" << endl;
 
-        cout << "Destroying thread" << endl;
-        worker_thread = {};
-        cout << "Thread destroyed" << endl;
+        decode_queue.stop();
+        decoders.clear();
+        cout << "Decoder threads stopped" << endl;
 
-        {
-            cout << "Clearing safe_cache" << endl;
-            auto cache = safe_cache.lock();
+        pending_requests.clear();
+        active_transfers.clear();
+        outstanding_requests = 0;
+
+        handle_slots.clear();
+        free_handle_slots.clear();
+
+        cout << "Clearing cache" << endl;
+        for (auto& shard : shards) {
+            auto cache = shard.lock();
 
             for (auto& [location, entry] : *cache)
-                destroy_entry(entry);
+                destroy_entry(*entry);
 
             cache->clear();
         }
 
+        {
+            auto clock = safe_clock.lock();
+            clock->ring.clear();
+            clock->hand = clock->ring.end();
+        }
+        cache_bytes = 0;
+
+        new_frame();
+
+        for (auto& atlas : atlases) {
+            for (auto& page : atlas.pages)
+                if (page.texture)
+                    SDL_DestroyTexture(page.texture);
+            atlas.pages.clear();
+        }
+        atlas_slack_bytes = 0;
+
+        {
+            auto encoded = safe_encoded.lock();
+            encoded->entries.clear();
+            encoded->total_bytes = 0;
+        }
+        buffers.clear();
+
+        worker.reset();
+        multi = nullptr;
+
+        disk.reset();
+
         cout << "Destroying predefined icons" << endl;
 
         if (loading_image) {
@@ -194,131 +677,669 @@ namespace ImageLoader {
         curl_global_cleanup();
     }
 
-    SDL_Texture* get(const std::string& location)
+    void post_request(const std::string& key)
     {
-        ++use_counter;
+        worker->post([key]
+        {
+            if (auto entry = find_entry(key)) {
+                pending_requests.push_back(std::move(entry));
+                schedule_requests();
+            }
+        });
+    }
 
-        auto cache = safe_cache.lock();
-        auto it = cache->find(location);
+    // Returns empty if nobody wants this image anymore.
+    static std::optional<Priority> priority_of(const CacheEntry& entry)
+    {
+        const auto now = current_frame.load();
+        const auto last_frame = entry.last_frame.load();
+
+        if (last_frame + 1 >= now)
+            return Priority::visible;
+        if (entry.prefetch_frame + prefetch_lifetime >= now)
+            return Priority::prefetch;
+        if (last_frame + background_lifetime >= now)
+            return Priority::background;
+        return {};
+    }
 
-        try {
-            if (it != cache->end()) {
-                auto& entry = it->second;
-                entry.last_use = use_counter;
+    // Locations that aren't URLs: "file://" paths, absolute paths like "fs:/vol/external01/...",
+    // and "ui/" for the app's own content.
+    static std::optional<std::filesystem::path> local_path(const std::string& location)
+    {
+        if (location.starts_with("file://"))
+            return location.substr(7);
+        if (location.starts_with("ui/"))
+            return content_prefix / location;
+        if (location.starts_with("fs:/") || location.starts_with("/"))
+            return location;
+        return {};
+    }
 
-                switch (entry.state.load()) {
-                    case LoadState::loaded:
-                        if (!entry.tex && entry.img) {
-                            entry.tex = SDL_CreateTextureFromSurface(renderer, entry.img);
-                            if (entry.tex)
-                                SDL_SetTextureBlendMode(entry.tex, SDL_BLENDMODE_BLEND);
+    // Frees the transfers of an entry in the loading state, and makes it unloaded.
+    static void cancel_transfers(CacheEntry& entry)
+    {
+        free_transfers(entry);
+        release_raw_buf(entry);
+        entry.cached.reset();
+        entry.state = LoadState::unloaded;
+    }
 
-                            SDL_FreeSurface(entry.img);
-                            entry.img = nullptr;
-                        }
+    // Runs on the worker thread.
+    static void start_transfer(CacheEntry& entry)
+    {
+        auto transfer = std::make_unique<Transfer>();
+        transfer->entry = &entry;
+        transfer->started = std::chrono::steady_clock::now();
+
+        auto* easy = transfer->easy = curl_easy_init();
+        if (!easy)
+            throw std::runtime_error{"curl_easy_init() failed"};
+
+        transfer->headers = curl_slist_append(transfer->headers, "Accept: image/*");
+
+        // Revalidate a stale copy: a 304 costs no bandwidth.
+        if (entry.cached) {
+            if (!entry.cached->etag.empty())
+                transfer->headers = curl_slist_append(transfer->headers,
+                                                      ("If-None-Match: " + entry.cached->etag).c_str());
+            if (!entry.cached->last_modified.empty())
+                transfer->headers = curl_slist_append(transfer->headers,
+                                                      ("If-Modified-Since: " + entry.cached->last_modified).c_str());
+        }
 
-                        if (entry.tex)
-                            return entry.tex;
+        curl_easy_setopt(easy, CURLOPT_URL, entry.location.c_str());
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->headers);
+        curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, 0L);
+        curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(easy, CURLOPT_AUTOREFERER, 1L);
+        curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(easy, CURLOPT_TRANSFER_ENCODING, 1L);
+        curl_easy_setopt(easy, CURLOPT_BUFFERSIZE, 65536L);
+        curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 0L);
+        curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, connect_timeout_ms);
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_LIMIT, low_speed_limit);
+        curl_easy_setopt(easy, CURLOPT_LOW_SPEED_TIME, low_speed_time);
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, write_cb);
+        curl_easy_setopt(easy, CURLOPT_MAXFILESIZE_LARGE, curl_off_t(max_image_bytes));
+        curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, header_cb);
+        curl_easy_setopt(easy, CURLOPT_HEADERDATA, transfer.get());
+        curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+
+        if (!user_agent.empty())
+            curl_easy_setopt(easy, CURLOPT_USERAGENT, user_agent.c_str());
+
+        curl_multi_add_handle(multi, easy);
+
+        entry.transfers.push_back(std::move(transfer));
+    }
 
-                        return load_error_image;
+    // Sends a second request for visible images whose first request got nothing yet.
+    static void hedge_slow_transfers()
+    {
+        const auto now = std::chrono::steady_clock::now();
 
-                    case LoadState::error:
-                        return load_error_image;
+        for (auto& entry : active_transfers) {
+            if (entry->transfers.size() != 1)
+                continue;
 
-                    case LoadState::requested:
-                    case LoadState::loading:
-                        return loading_image;
+            auto& first = *entry->transfers.front();
+            if (!first.body.empty() || now - first.started < hedge_after)
+                continue;
 
-                    case LoadState::unloaded:
-                        entry.state = LoadState::requested;
-                        requests_queue.push(location);
-                        return loading_image;
+            if (priority_of(*entry) != Priority::visible)
+                continue;
 
-                    default:
-                        throw std::logic_error{
-                            "invalid entry state: " + to_string(entry.state.load())
-                        };
+            try {
+                cout << "ImageLoader: sending a second request for " << entry->location << endl;
+                start_transfer(*entry);
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR: ImageLoader::hedge_slow_transfers(): " << e.what() << endl;
+            }
+        }
+    }
+
+    // Runs on the worker thread.
+    void schedule_requests()
+    {
+        std::erase_if(active_transfers,
+                      [](const std::shared_ptr<CacheEntry>& entry)
+                      {
+                          if (priority_of(*entry))
+                              return false;
+                          cancel_transfers(*entry);
+                          return true;
+                      });
+
+        hedge_slow_transfers();
+
+        std::erase_if(pending_requests,
+                      [](const std::shared_ptr<CacheEntry>& entry)
+                      {
+                          if (priority_of(*entry))
+                              return false;
+                          entry->state = LoadState::unloaded;
+                          return true;
+                      });
+
+        // NOTE: the sort is stable, so each priority is still served in arrival order.
+        std::ranges::stable_sort(pending_requests,
+                                 {},
+                                 [](const std::shared_ptr<CacheEntry>& entry)
+                                 {
+                                     return priority_of(*entry).value_or(Priority::background);
+                                 });
+
+        auto next = pending_requests.begin();
+        while (next != pending_requests.end() && active_transfers.size() < max_transfers) {
+            auto entry = std::move(*next++);
+            if (process_one_request(*entry))
+                active_transfers.push_back(std::move(entry));
+        }
+        pending_requests.erase(pending_requests.begin(), next);
+
+        outstanding_requests = pending_requests.size() + active_transfers.size();
+    }
+
+    static Atlas* find_atlas(const CacheEntry& entry)
+    {
+        if (!entry.use_atlas)
+            return nullptr;
+
+        for (auto& atlas : atlases)
+            if (atlas.slot_width == entry.max_width && atlas.slot_height == entry.max_height)
+                return &atlas;
+
+        return nullptr;
+    }
+
+    static std::optional<AtlasSlot> allocate_slot(Atlas& atlas)
+    {
+        const int columns = atlas_page_width / atlas.slot_width;
+        const int rows = atlas_page_height / atlas.slot_height;
+        const unsigned capacity = columns * rows;
+
+        for (std::size_t p = 0; p < atlas.pages.size(); ++p) {
+            auto& page = atlas.pages[p];
+            if (!page.texture || page.used_count >= capacity)
+                continue;
+
+            for (unsigned i = 0; i < capacity; ++i)
+                if (!page.used[i]) {
+                    page.used[i] = true;
+                    ++page.used_count;
+                    return AtlasSlot{static_cast<int>(p), static_cast<int>(i)};
+                }
+        }
+
+        // All pages are full; take the place of a destroyed page, or add a new one.
+        auto it = std::ranges::find(atlas.pages, nullptr, &AtlasPage::texture);
+        if (it == atlas.pages.end()) {
+            if (atlas.pages.size() >= max_atlas_pages)
+                return {};
+            it = atlas.pages.emplace(atlas.pages.end());
+        }
+
+        it->texture = SDL_CreateTexture(renderer,
+                                        native_format,
+                                        SDL_TEXTUREACCESS_STATIC,
+                                        atlas_page_width,
+                                        atlas_page_height);
+        if (!it->texture) {
+            cerr << "ERROR: ImageLoader: could not create atlas page: " << SDL_GetError() << endl;
+            return {};
+        }
+        SDL_SetTextureBlendMode(it->texture, SDL_BLENDMODE_BLEND);
+        atlas_slack_bytes += atlas_page_bytes();
+
+        it->used.assign(capacity, false);
+        it->used[0] = true;
+        it->used_count = 1;
+
+        return AtlasSlot{static_cast<int>(it - atlas.pages.begin()), 0};
+    }
+
+    static void release_slot(int atlas_idx, AtlasSlot slot)
+    {
+        auto& page = atlases[atlas_idx].pages[slot.page];
+        page.used[slot.index] = false;
+        atlas_slack_bytes += slot.bytes;
+
+        if (--page.used_count == 0) {
+            SDL_DestroyTexture(page.texture);
+            page.texture = nullptr;
+            atlas_slack_bytes -= atlas_page_bytes();
+        }
+    }
+
+    // Copies entry.img into an atlas slot; returns false if it doesn't belong in one.
+    static bool upload_to_atlas(CacheEntry& entry)
+    {
+        auto* atlas = find_atlas(entry);
+        if (!atlas || entry.img->w > atlas->slot_width || entry.img->h > atlas->slot_height)
+            return false;
+
+        SDL_Surface* src = entry.img;
+        if (src->format->format != native_format) {
+            src = SDL_ConvertSurfaceFormat(entry.img, native_format, 0);
+            if (!src)
+                return false;
+        }
+
+        const int atlas_idx = static_cast<int>(atlas - atlases.data());
+        bool uploaded = false;
+
+        if (auto slot = allocate_slot(*atlas)) {
+            const int columns = atlas_page_width / atlas->slot_width;
+            SDL_Rect rect{
+                (slot->index % columns) * atlas->slot_width,
+                (slot->index / columns) * atlas->slot_height,
+                src->w,
+                src->h
+            };
+
+            auto* page_tex = atlas->pages[slot->page].texture;
+            if (SDL_UpdateTexture(page_tex, &rect, src->pixels, src->pitch) == 0) {
+                slot->bytes = entry.bytes;
+                atlas_slack_bytes -= slot->bytes;
+                entry.atlas = atlas_idx;
+                entry.atlas_slot = *slot;
+                entry.uv0 = {float(rect.x) / atlas_page_width,
+                             float(rect.y) / atlas_page_height};
+                entry.uv1 = {float(rect.x + rect.w) / atlas_page_width,
+                             float(rect.y + rect.h) / atlas_page_height};
+                uploaded = true;
+            }
+            else
+                release_slot(atlas_idx, *slot);
+        }
+
+        if (src != entry.img)
+            SDL_FreeSurface(src);
+
+        return uploaded;
+    }
+
+    // Turns entry.img into a texture or atlas slot, unless this frame's budget is used up.
+    static bool upload(CacheEntry& entry)
+    {
+        const std::size_t bytes = static_cast<std::size_t>(entry.img->pitch) * entry.img->h;
+
+        if (upload_stats.textures > 0
+            && (upload_stats.textures >= max_uploads_per_frame
+                || upload_stats.bytes + bytes > max_upload_bytes_per_frame))
+            return false;
+
+        const auto start = SDL_GetPerformanceCounter();
+
+        if (!upload_to_atlas(entry)) {
+            SDL_Surface* src = entry.img;
+            if (src->format->format != native_format)
+                src = SDL_ConvertSurfaceFormat(entry.img, native_format, 0);
+
+            if (src) {
+                entry.tex = SDL_CreateTexture(renderer,
+                                              src->format->format,
+                                              SDL_TEXTUREACCESS_STATIC,
+                                              src->w,
+                                              src->h);
+                if (entry.tex) {
+                    SDL_UpdateTexture(entry.tex, nullptr, src->pixels, src->pitch);
+                    SDL_SetTextureBlendMode(entry.tex, SDL_BLENDMODE_BLEND);
                 }
+
+                if (src != entry.img)
+                    SDL_FreeSurface(src);
             }
+        }
+
+        SDL_FreeSurface(entry.img);
+        entry.img = nullptr;
+
+        const auto elapsed = SDL_GetPerformanceCounter() - start;
+        ++upload_stats.textures;
+        upload_stats.bytes += bytes;
+        upload_stats.milliseconds += elapsed * 1000.0 / SDL_GetPerformanceFrequency();
+
+        return true;
+    }
+
+    UploadStats get_upload_stats()
+    {
+        return last_upload_stats;
+    }
+
+    void new_frame()
+    {
+        // Priorities change as things scroll in and out of view.
+        if (++current_frame % 8 == 0 && outstanding_requests && worker)
+            worker->post(schedule_requests);
+
+        last_upload_stats = std::exchange(upload_stats, {});
+
+        // Same rule as is_evictable(): anything not drawn in the previous frame.
+        for (auto& slot : handle_slots)
+            if (slot.entry && slot.entry->last_frame + 1 < current_frame)
+                slot.entry.reset();
+
+        Retired retired;
+        std::swap(retired, *safe_retired.lock());
 
-            auto& entry = (*cache)[location];
-            entry.state = LoadState::requested;
-            entry.last_use = use_counter;
+        for (auto* tex : retired.textures)
+            SDL_DestroyTexture(tex);
 
-            requests_queue.push(location);
+        for (auto [atlas_idx, slot] : retired.atlas_slots)
+            release_slot(atlas_idx, slot);
+
+        // A new atlas page, or one kept by a few slots, may be over the budget; decodes
+        // trim the cache too, but there may be none coming.
+        if (current_frame % 8 == 0 && is_over_budget() && worker)
+            worker->post(trim_cache);
+    }
+
+    void set_cache_budget(std::size_t bytes)
+    {
+        max_cache_bytes = bytes;
+    }
+
+    static std::string make_key(const std::string& location,
+                                int max_width,
+                                int max_height,
+                                bool use_atlas)
+    {
+        std::string key = location;
+        if (max_width > 0 && max_height > 0)
+            key += "#" + std::to_string(max_width) + "x" + std::to_string(max_height);
+        if (use_atlas)
+            key += "@atlas";
+        return key;
+    }
 
-            return loading_image;
+    static std::shared_ptr<CacheEntry> find_or_create_entry(const std::string& location,
+                                                            float width,
+                                                            float height,
+                                                            bool use_atlas)
+    {
+        const int max_width = static_cast<int>(std::ceil(width));
+        const int max_height = static_cast<int>(std::ceil(height));
+
+        const std::string key = make_key(location, max_width, max_height, use_atlas);
+
+        if (auto entry = find_entry(key))
+            return entry;
+
+        // The entry goes into the shard and the ring under both locks, clock first;
+        // otherwise forget() could drop it in between, and leave it dangling in the ring.
+        auto clock = safe_clock.lock();
+        auto cache = shard_for(key).lock();
+        auto& slot = (*cache)[key];
+        if (!slot) {
+            slot = std::make_shared<CacheEntry>();
+            slot->key = key;
+            slot->location = location;
+            slot->max_width = max_width;
+            slot->max_height = max_height;
+            slot->use_atlas = use_atlas;
+            clock->ring.insert(clock->hand, slot.get());
+        }
+        return slot;
+    }
+
+    // Marks the entry as drawn in this frame, and returns what to draw for it.
+    static Image resolve(CacheEntry& entry)
+    {
+        entry.last_frame = current_frame.load();
+        entry.referenced = true;
+
+        switch (entry.state.load()) {
+            case LoadState::loaded:
+                if (!entry.tex && entry.atlas < 0 && entry.img)
+                    if (!upload(entry))
+                        return {loading_image};
+
+                if (entry.atlas >= 0) {
+                    auto& page = atlases[entry.atlas].pages[entry.atlas_slot.page];
+                    return {page.texture, entry.uv0, entry.uv1};
+                }
+
+                if (entry.tex)
+                    return {entry.tex};
+
+                return {load_error_image};
+
+            case LoadState::error:
+                if (std::chrono::steady_clock::now() >= entry.retry_at) {
+                    entry.state = LoadState::requested;
+                    post_request(entry.key);
+                    return {loading_image};
+                }
+                if (entry.missing)
+                    return {loading_image};
+                return {load_error_image};
+
+            case LoadState::requested:
+            case LoadState::loading:
+            case LoadState::decoding:
+                return {loading_image};
+
+            case LoadState::unloaded:
+                entry.state = LoadState::requested;
+                post_request(entry.key);
+                return {loading_image};
+
+            default:
+                throw std::logic_error{
+                    "invalid entry state: " + to_string(entry.state.load())
+                };
+        }
+    }
+
+    static Image get_impl(const std::string& location, float width, float height, bool use_atlas)
+    {
+        try {
+            auto entry = find_or_create_entry(location, width, height, use_atlas);
+            return resolve(*entry);
         }
         catch (std::exception& e) {
             cerr << "ERROR: ImageLoader::get(): " << e.what() << endl;
-            return load_error_image;
+            return {load_error_image};
         }
     }
 
-    CacheEntry* find(thread_safe<cache_t>::guard<cache_t>& cache, CURL* easy)
+    SDL_Texture* get(const std::string& location)
     {
-        for (auto& [location, entry] : *cache) {
-            if (entry.easy == easy)
-                return &entry;
-        }
+        return get_impl(location, 0, 0, false).texture;
+    }
 
-        return nullptr;
+    SDL_Texture* get(const std::string& location, float width, float height)
+    {
+        return get_impl(location, width, height, false).texture;
     }
 
-    void process_one_request(const std::string& location)
+    Image get_image(const std::string& location, float width, float height)
     {
-        auto cache = safe_cache.lock();
-        auto it = cache->find(location);
+        return get_impl(location, width, height, true);
+    }
 
-        if (it == cache->end())
+    static HandleSlot* find_slot(Handle handle)
+    {
+        if (handle.index >= handle_slots.size())
+            return nullptr;
+
+        auto& slot = handle_slots[handle.index];
+        if (!slot.in_use || slot.generation != handle.generation)
+            return nullptr;
+
+        return &slot;
+    }
+
+    Handle make_handle(const std::string& location, float width, float height)
+    {
+        std::uint32_t index;
+        if (free_handle_slots.empty()) {
+            index = handle_slots.size();
+            handle_slots.emplace_back();
+        }
+        else {
+            index = free_handle_slots.back();
+            free_handle_slots.pop_back();
+        }
+
+        auto& slot = handle_slots[index];
+        slot.location = location;
+        slot.width = width;
+        slot.height = height;
+        slot.in_use = true;
+
+        return {index, slot.generation};
+    }
+
+    void release(Handle handle)
+    {
+        auto slot = find_slot(handle);
+        if (!slot)
             return;
 
-        auto& entry = it->second;
+        slot->entry.reset();
+        slot->location.clear();
+        slot->in_use = false;
+        if (!++slot->generation)
+            slot->generation = 1;
+
+        free_handle_slots.push_back(handle.index);
+    }
+
+    Image get_image(Handle handle)
+    {
+        auto slot = find_slot(handle);
+        if (!slot)
+            return {load_error_image};
+
+        try {
+            if (slot->entry && slot->entry->forgotten)
+                slot->entry.reset();
+
+            // Only the first frame it's drawn in, or after it was evicted.
+            if (!slot->entry)
+                slot->entry = find_or_create_entry(slot->location, slot->width, slot->height, true);
+
+            return resolve(*slot->entry);
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ImageLoader::get_image(): " << e.what() << endl;
+            return {load_error_image};
+        }
+    }
+
+    // The texture for a variant that's already loaded, or null; doesn't start a request.
+    static SDL_Texture* get_if_loaded(const std::string& location, float width, float height)
+    {
+        const auto key = make_key(location,
+                                  static_cast<int>(std::ceil(width)),
+                                  static_cast<int>(std::ceil(height)),
+                                  false);
+        auto entry = find_entry(key);
+        if (!entry || entry->state != LoadState::loaded)
+            return nullptr;
+
+        auto tex = get(location, width, height);
+        if (tex == load_error_image || tex == loading_image)
+            return nullptr;
+        return tex;
+    }
+
+    SDL_Texture* get(const std::vector<Variant>& variants, float width, float height)
+    {
+        if (variants.empty())
+            return load_error_image;
+
+        // The smallest variant that covers the draw size; there's no point in more.
+        std::size_t needed = 0;
+        while (needed + 1 < variants.size()
+               && (variants[needed].width < width || variants[needed].height < height))
+            ++needed;
+
+        // Assume about 2 bits per pixel once compressed.
+        std::size_t target = needed;
+        if (const double bw = bandwidth; bw > 0)
+            while (target > 0
+                   && variants[target].width * variants[target].height / 4.0 / bw
+                      > max_variant_seconds)
+                --target;
+
+        // Anything between what we need and what we'd fetch now is good, if it's loaded.
+        for (std::size_t i = needed + 1; i-- > target;)
+            if (auto tex = get_if_loaded(variants[i].location, width, height))
+                return tex;
+
+        // Request the smallest first, so something shows up quickly on slow links.
+        auto smallest = get(variants[0].location, width, height);
+        if (target == 0)
+            return smallest;
+
+        get(variants[target].location, width, height);
+
+        for (std::size_t i = target; --i > 0;)
+            if (auto tex = get_if_loaded(variants[i].location, width, height))
+                return tex;
+
+        return smallest;
+    }
+
+    void prefetch(const std::string& location, float width, float height)
+    {
+        try {
+            auto entry = find_or_create_entry(location, width, height, true);
+            entry->prefetch_frame = current_frame.load();
+            entry->referenced = true;
+
+            LoadState expected = LoadState::unloaded;
+            if (entry->state.compare_exchange_strong(expected, LoadState::requested))
+                post_request(entry->key);
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ImageLoader::prefetch(): " << e.what() << endl;
+        }
+    }
+
+    // Returns true if a transfer was started.
+    bool process_one_request(CacheEntry& entry)
+    {
+        const auto& location = entry.location;
 
         LoadState expected = LoadState::requested;
         if (!entry.state.compare_exchange_strong(expected, LoadState::loading)) {
             cerr << "ERROR: ImageLoader::process_one_request() wrong cache entry state: "
                  << to_string(expected)
                  << endl;
-            return;
+            return false;
         }
 
-        entry.location = location;
-
         try {
             if (location.starts_with("http://") || location.starts_with("https://")) {
-                entry.easy = curl_easy_init();
-                if (!entry.easy)
-                    throw std::runtime_error{"curl_easy_init() failed"};
-
-                entry.headers = curl_slist_append(entry.headers, "Accept: image/*");
-
-                curl_easy_setopt(entry.easy, CURLOPT_URL, location.c_str());
-                curl_easy_setopt(entry.easy, CURLOPT_HTTPHEADER, entry.headers);
-                curl_easy_setopt(entry.easy, CURLOPT_SSL_VERIFYPEER, 0L);
-                curl_easy_setopt(entry.easy, CURLOPT_FOLLOWLOCATION, 1L);
-                curl_easy_setopt(entry.easy, CURLOPT_AUTOREFERER, 1L);
-                curl_easy_setopt(entry.easy, CURLOPT_ACCEPT_ENCODING, "");
-                curl_easy_setopt(entry.easy, CURLOPT_TRANSFER_ENCODING, 1L);
-                curl_easy_setopt(entry.easy, CURLOPT_BUFFERSIZE, 65536L);
-                curl_easy_setopt(entry.easy, CURLOPT_TCP_NODELAY, 0L);
-                curl_easy_setopt(entry.easy, CURLOPT_FAILONERROR, 1L);
-                curl_easy_setopt(entry.easy, CURLOPT_WRITEFUNCTION, write_cb);
-                curl_easy_setopt(entry.easy, CURLOPT_WRITEDATA, &entry);
-
-                if (!user_agent.empty())
-                    curl_easy_setopt(entry.easy, CURLOPT_USERAGENT, user_agent.c_str());
-
-                curl_multi_add_handle(multi, entry.easy);
-            }
-            else if (location.starts_with("ui/")) {
-                const auto path = content_prefix / location;
-
-                entry.img = IMG_Load(path.string().c_str());
-                if (!entry.img)
-                    throw std::runtime_error{IMG_GetError()};
+                if (disk)
+                    entry.cached = disk->lookup(location);
+
+                if (entry.cached && disk_cache::is_fresh(*entry.cached)) {
+                    if (auto data = disk->read(location)) {
+                        entry.raw_buf = std::move(data);
+                        entry.state = LoadState::decoding;
+                        decode_queue.push(entry.shared_from_this());
+                        return false;
+                    }
+                    entry.cached.reset();
+                }
 
-                entry.state = LoadState::loaded;
+                start_transfer(entry);
+                return true;
+            }
+            else if (local_path(location)) {
+                // Reading the SD card is slow too, the decoders do it.
+                entry.state = LoadState::decoding;
+                decode_queue.push(entry.shared_from_this());
             }
             else {
                 throw std::runtime_error{"invalid location"};
@@ -329,201 +1350,402 @@ namespace ImageLoader {
                        "ERROR: ImageLoader::process_one_request(): location=\"{}\", exception={}",
                        location,
                        e.what());
-            
-            entry.state = LoadState::error;
+
+            free_transfers(entry);
+            mark_failed(entry);
         }
+
+        return false;
     }
 
-    template<std::ranges::random_access_range R,
-             typename Comp = std::ranges::less,
-             class Proj = std::identity>
-    requires std::sortable<std::ranges::iterator_t<R>, Comp, Proj>
-    void sift_down_heap(R&& r, Comp comp = {}, Proj proj = {})
+    // Entries that are in flight, or were drawn in this or the previous frame, stay.
+    static bool is_evictable(const CacheEntry& entry)
     {
-        if (std::empty(r))
-            return;
+        if (entry.last_frame + 1 >= current_frame)
+            return false;
+
+        switch (entry.state.load()) {
+            case LoadState::unloaded:
+            case LoadState::loaded:
+            case LoadState::error:
+                return true;
+            default:
+                return false;
+        }
+    }
 
-        const auto size = std::size(r);
-        std::ranges::range_size_t<R> cur_idx = 0;
+    // Second-chance (CLOCK) eviction, until both budgets are respected.
+    void trim_cache()
+    {
+        auto clock = safe_clock.lock();
+        auto& ring = clock->ring;
+        auto& hand = clock->hand;
 
-        for (;;) {
-            auto left_idx = 2u * cur_idx + 1u;
+        // Give up after two full turns, everything left is pinned.
+        std::size_t steps = 2 * ring.size();
 
-            if (left_idx >= size)
-                break;
+        while ((is_over_budget() || ring.size() > max_cache_entries)
+               && !ring.empty()
+               && steps--) {
+
+            if (hand == ring.end())
+                hand = ring.begin();
 
-            auto next_idx = left_idx;
-            auto right_idx = 2u * cur_idx + 2u;
+            CacheEntry* candidate = *hand;
 
-            if (right_idx < size &&
-                std::invoke(comp,
-                            std::invoke(proj, r[left_idx]),
-                            std::invoke(proj, r[right_idx]))) {
-                next_idx = right_idx;
+            if (candidate->referenced.exchange(false) || !is_evictable(*candidate)) {
+                ++hand;
+                continue;
             }
 
-            if (!std::invoke(comp,
-                             std::invoke(proj, r[cur_idx]),
-                             std::invoke(proj, r[next_idx]))) {
-                break;
+            std::shared_ptr<CacheEntry> victim;
+            {
+                auto cache = shard_for(candidate->key).lock();
+                auto it = cache->find(candidate->key);
+                // Someone else holds it, like get() on the UI thread.
+                if (it != cache->end() && it->second.use_count() == 1) {
+                    victim = std::move(it->second);
+                    cache->erase(it);
+                }
             }
 
-            std::swap(r[cur_idx], r[next_idx]);
-            cur_idx = next_idx;
+            if (!victim) {
+                ++hand;
+                continue;
+            }
+
+            hand = ring.erase(hand);
+            retire_entry(*victim);
         }
     }
 
-    std::uint64_t& by_last_use(cache_t::iterator it) noexcept
+    static SDL_Surface* downscale(SDL_Surface* img, int max_width, int max_height)
     {
-        return it->second.last_use;
+        if (max_width <= 0 || max_height <= 0)
+            return img;
+        if (img->w <= max_width && img->h <= max_height)
+            return img;
+
+        const float scale = std::min(float(max_width) / img->w, float(max_height) / img->h);
+        const int w = std::max(1, static_cast<int>(std::lround(img->w * scale)));
+        const int h = std::max(1, static_cast<int>(std::lround(img->h * scale)));
+
+        // NOTE: SDL_SoftStretchLinear() needs 32-bit pixels in the same format.
+        SDL_Surface* src = img;
+        if (img->format->BytesPerPixel != 4) {
+            src = SDL_ConvertSurfaceFormat(img, SDL_PIXELFORMAT_ARGB8888, 0);
+            if (!src)
+                return img;
+        }
+
+        SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, src->format->format);
+        if (dst && SDL_SoftStretchLinear(src, nullptr, dst, nullptr) == 0) {
+            if (src != img)
+                SDL_FreeSurface(src);
+            SDL_FreeSurface(img);
+            return dst;
+        }
+
+        cerr << "WARNING: ImageLoader: failed to downscale: " << SDL_GetError() << endl;
+        if (dst)
+            SDL_FreeSurface(dst);
+        if (src != img)
+            SDL_FreeSurface(src);
+        return img;
     }
 
-    void trim_cache()
+    // Downloaded thumbnails get their pixels saved next to them, see pixel_sidecar. A
+    // thumbnail only has one sidecar, so it's kept for the size the theme lists draw it
+    // at; other sizes would keep replacing it with their own.
+    static bool wants_sidecar(const CacheEntry& entry, const std::filesystem::path& path)
     {
-        auto cache = safe_cache.lock();
+        return path.parent_path() == THEMIIFY_THUMBNAILS
+            && entry.max_width == atlases[0].slot_width
+            && entry.max_height == atlases[0].slot_height;
+    }
 
-        if (cache->size() <= max_cache_size)
-            return;
+    // Decodes entry.raw_buf, or the local file, into entry.img
+    void decode_entry(CacheEntry& entry)
+    {
+        const auto path = local_path(entry.location);
+        const bool use_sidecar = path && wants_sidecar(entry, *path);
 
-        std::size_t excess = cache->size() - max_cache_size;
+        try {
+            bool from_sidecar = false;
+
+            if (path) {
+                std::error_code ec;
+                if (!exists(*path, ec)) {
+                    entry.missing = true;
+                    mark_failed(entry, false);
+                    return;
+                }
 
-        std::vector<cache_t::iterator> to_remove(excess);
-        auto to_remove_end = to_remove.begin();
+                if (use_sidecar) {
+                    entry.img = pixel_sidecar::load(*path,
+                                                    native_format,
+                                                    entry.max_width,
+                                                    entry.max_height);
+                    from_sidecar = entry.img != nullptr;
+                }
 
-        for (auto it = cache->begin(); it != cache->end(); ++it) {
-            if (to_remove_end != to_remove.end()) {
-                *to_remove_end++ = it;
-                std::ranges::push_heap(to_remove.begin(),
-                                       to_remove_end,
-                                       {},
-                                       by_last_use);
+                if (!entry.img)
+                    entry.img = IMG_Load(path->string().c_str());
+                if (!entry.img)
+                    throw std::runtime_error{IMG_GetError()};
             }
             else {
-                if (by_last_use(it) < by_last_use(to_remove.front())) {
-                    to_remove.front() = it;
-                    sift_down_heap(to_remove, {}, by_last_use);
+                if (!entry.raw_buf || entry.raw_buf->empty())
+                    throw std::runtime_error{"no data"};
+
+                SDL_RWops* rw = SDL_RWFromConstMem(entry.raw_buf->data(),
+                                                   static_cast<int>(entry.raw_buf->size()));
+                if (!rw)
+                    throw std::runtime_error{SDL_GetError()};
+
+                entry.img = IMG_Load_RW(rw, 1);
+                if (!entry.img)
+                    throw std::runtime_error{IMG_GetError()};
+            }
+
+            // A sidecar already has the pixels the way they're needed.
+            if (!from_sidecar) {
+                entry.img = downscale(entry.img, entry.max_width, entry.max_height);
+
+                if (entry.img->format->format != native_format) {
+                    if (auto converted = SDL_ConvertSurfaceFormat(entry.img, native_format, 0)) {
+                        SDL_FreeSurface(entry.img);
+                        entry.img = converted;
+                    }
                 }
             }
+
+            if (use_sidecar && !from_sidecar && entry.img->format->format == native_format)
+                pixel_sidecar::save(*path, entry.img, entry.max_width, entry.max_height);
+
+            entry.bytes = static_cast<std::size_t>(entry.img->pitch) * entry.img->h;
+            cache_bytes += entry.bytes;
+
+            entry.failures = 0;
+            entry.missing = false;
+            entry.state = LoadState::loaded;
+
+            if (entry.raw_buf)
+                remember_encoded(entry.location, std::move(*entry.raw_buf));
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ImageLoader::decode_entry(): " << entry.location << ": " << e.what() << endl;
+            // A broken download may come out right next time, a broken file won't.
+            mark_failed(entry, !path);
         }
 
-        for (auto it : to_remove) {
-            destroy_entry(it->second);
-            cache->erase(it);
+        release_raw_buf(entry);
+    }
+
+    void decoder_func()
+    {
+        for (;;) {
+            try {
+                auto entry = decode_queue.pop();
+                decode_entry(*entry);
+                entry.reset();
+                trim_cache();
+            }
+            catch (async_queue_error) {
+                break;
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR: ImageLoader::decoder_func(): " << e.what() << endl;
+            }
         }
     }
 
-    void handle_finished_downloads()
+    static void update_bandwidth(CURL* easy)
     {
-        int msgs_left = 0;
+        curl_off_t size = 0;
+        curl_off_t micros = 0;
+        curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &size);
+        curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME_T, &micros);
+        if (size < min_bandwidth_sample || micros <= 0)
+            return;
 
-        while (auto* msg = curl_multi_info_read(multi, &msgs_left)) {
-            if (msg->msg != CURLMSG_DONE)
-                continue;
+        const double sample = size * 1e6 / micros;
+        const double old = bandwidth;
+        bandwidth = old > 0 ? 0.75 * old + 0.25 * sample : sample;
+    }
 
-            CURL* easy = msg->easy_handle;
+    void handle_finished_download(CURLMsg* msg)
+    {
+        CURL* easy = msg->easy_handle;
+        CURLcode result = msg->data.result;
 
-            auto cache = safe_cache.lock();
-            auto* entry = find(cache, easy);
+        Transfer* transfer = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &transfer);
 
-            if (!entry) {
-                cerr << "ERROR: ImageLoader::handle_finished_downloads(): failed to find entry" << endl;
-                curl_multi_remove_handle(multi, easy);
-                curl_easy_cleanup(easy);
-                continue;
-            }
+        if (!transfer) {
+            cerr << "ERROR: ImageLoader::handle_finished_download(): failed to find transfer" << endl;
+            curl_multi_remove_handle(multi, easy);
+            curl_easy_cleanup(easy);
+            return;
+        }
 
-            try {
-                if (msg->data.result != CURLE_OK) {
+        auto* entry = transfer->entry;
+
+        long status = 0;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+
+        // The other request may still succeed.
+        if (result != CURLE_OK && entry->transfers.size() > 1) {
+            cerr << "WARNING: ImageLoader: one of the requests for " << entry->location
+                 << " failed: " << curl_easy_strerror(result) << endl;
+            free_transfer(*transfer);
+            std::erase_if(entry->transfers,
+                          [transfer](const std::unique_ptr<Transfer>& t)
+                          {
+                              return t.get() == transfer;
+                          });
+            return;
+        }
+
+        // Client errors won't fix themselves, except for timeouts and rate limiting.
+        bool transient = !(status >= 400 && status < 500 && status != 408 && status != 429);
+
+        try {
+            if (entry->cached && (status == 304 || result != CURLE_OK)) {
+                // Not modified, or we're offline: the copy on disk will do.
+                if (result == CURLE_OK)
+                    disk->refresh(entry->location, transfer->response.max_age);
+                else
+                    cerr << "WARNING: ImageLoader: using cached " << entry->location
+                         << ": " << curl_easy_strerror(result) << endl;
+
+                entry->raw_buf = disk->read(entry->location);
+                if (!entry->raw_buf)
+                    throw std::runtime_error{"failed to read disk cache"};
+            }
+            else {
+                if (result != CURLE_OK) {
                     throw std::runtime_error{
-                        curl_easy_strerror(msg->data.result)
+                        curl_easy_strerror(result)
                     };
                 }
 
+                update_bandwidth(easy);
+
                 char* content_type = nullptr;
                 curl_easy_getinfo(easy, CURLINFO_CONTENT_TYPE, &content_type);
 
                 std::string ct = content_type ? content_type : "";
                 if (!ct.starts_with("image/")) {
+                    transient = false;
                     throw std::runtime_error{
                         "Content-Type should be image/* but got \"" + ct + "\""
                     };
                 }
 
-                if (!entry->raw_buf || entry->raw_buf->empty())
+                if (transfer->body.empty())
                     throw std::runtime_error{"empty download"};
 
-                SDL_RWops* rw = SDL_RWFromConstMem(entry->raw_buf->data(),
-                                                   static_cast<int>(entry->raw_buf->size()));
-                if (!rw)
-                    throw std::runtime_error{SDL_GetError()};
+                entry->raw_buf = std::move(transfer->body);
 
-                entry->img = IMG_Load_RW(rw, 1);
-                if (!entry->img)
-                    throw std::runtime_error{IMG_GetError()};
-
-                entry->state = LoadState::loaded;
-            }
-            catch (std::exception& e) {
-                cerr << "ERROR: ImageLoader::handle_finished_downloads(): " << e.what() << endl;
-                entry->state = LoadState::error;
-            }
-
-            curl_multi_remove_handle(multi, entry->easy);
-
-            if (entry->headers) {
-                curl_slist_free_all(entry->headers);
-                entry->headers = nullptr;
+                if (disk && transfer->response.max_age >= 0) {
+                    try {
+                        disk->store(entry->location, *entry->raw_buf, transfer->response);
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: ImageLoader: could not store in disk cache: " << e.what() << endl;
+                    }
+                }
             }
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ImageLoader::handle_finished_download(): " << entry->location
+                 << ": " << e.what() << endl;
+            release_raw_buf(*entry);
+        }
 
-            if (entry->easy) {
-                curl_easy_cleanup(entry->easy);
-                entry->easy = nullptr;
-            }
+        // Whichever request finished first wins, the other one is dropped.
+        free_transfers(*entry);
+        entry->cached.reset();
 
-            entry->raw_buf.reset();
+        if (entry->raw_buf) {
+            entry->state = LoadState::decoding;
+            decode_queue.push(entry->shared_from_this());
         }
+        else {
+            mark_failed(*entry, transient);
+        }
+
+        std::erase_if(active_transfers,
+                      [entry](const std::shared_ptr<CacheEntry>& e)
+                      {
+                          return e.get() == entry;
+                      });
+        schedule_requests();
     }
 
-    void worker_func(std::stop_token token)
+    void forget(const std::string& location)
     {
-        try {
-            multi = curl_multi_init();
-            if (!multi)
-                throw std::runtime_error{"curl_multi_init() failed"};
+        auto clock = safe_clock.lock();
 
-            curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, 10L);
-            curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 10L);
+        for (auto& shard : shards) {
+            auto cache = shard.lock();
 
-            while (!token.stop_requested()) {
-                auto location = requests_queue.try_pop_for(50ms);
+            for (auto it = cache->begin(); it != cache->end();) {
+                auto& entry = it->second;
 
-                if (location) {
-                    process_one_request(*location);
-                }
-                else if (location.error() == async_queue_error::stop) {
-                    break;
-                }
-                else if (location.error() == async_queue_error::locked) {
-                    cout << "WARNING: requests_queue was locked" << endl;
+                bool idle = false;
+                switch (entry->state.load()) {
+                    case LoadState::unloaded:
+                    case LoadState::loaded:
+                    case LoadState::error:
+                        idle = true;
+                        break;
+                    default:
+                        break;
                 }
 
-                int running = 0;
-                curl_multi_perform(multi, &running);
-
-                handle_finished_downloads();
-                trim_cache();
+                if (entry->location != location || !idle) {
+                    ++it;
+                    continue;
+                }
 
-                std::this_thread::sleep_for(50ms);
+                auto pos = std::ranges::find(clock->ring, entry.get());
+                if (pos == clock->hand)
+                    clock->hand = clock->ring.erase(pos);
+                else if (pos != clock->ring.end())
+                    clock->ring.erase(pos);
+
+                // Like in trim_cache(), the pixels can only go if nobody else holds it;
+                // a handle that does lets go of it when it's drawn next.
+                if (entry.use_count() == 1)
+                    retire_entry(*entry);
+                else
+                    entry->forgotten = true;
+                it = cache->erase(it);
             }
         }
-        catch (std::exception& e) {
-            cerr << "ERROR: ImageLoader::worker_func(): " << e.what() << endl;
-        }
+    }
 
-        if (multi) {
-            curl_multi_cleanup(multi);
-            multi = nullptr;
-        }
+    void clear_disk_cache()
+    {
+        if (disk)
+            disk->clear();
+    }
+
+    std::optional<std::vector<char>> take_encoded(const std::string& location)
+    {
+        auto encoded = safe_encoded.lock();
+
+        auto it = std::ranges::find(encoded->entries, location, &EncodedEntry::location);
+        if (it == encoded->entries.end())
+            return {};
+
+        encoded->total_bytes -= it->data.size();
+        auto data = std::move(it->data);
+        encoded->entries.erase(it);
+
+        return data;
     }
 
     std::string to_string(LoadState st)
@@ -535,6 +1757,8 @@ namespace ImageLoader {
                 return "requested";
             case LoadState::loading:
                 return "loading";
+            case LoadState::decoding:
+                return "decoding";
             case LoadState::loaded:
                 return "loaded";
             case LoadState::error:
@@ -9,14 +9,93 @@
 
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <vector>
 
 #include <SDL2/SDL.h>
+#include <imgui.h>
 
 namespace ImageLoader {
+    struct UploadStats {
+        unsigned textures = 0;
+        std::size_t bytes = 0;
+        double milliseconds = 0;
+    };
+
+    // One of the resolutions an image is available in.
+    struct Variant {
+        std::string location;
+        int width;
+        int height;
+    };
+
+    // A texture, and the part of it that holds the image.
+    struct Image {
+        SDL_Texture *texture = nullptr;
+        ImVec2 uv0{0, 0};
+        ImVec2 uv1{1, 1};
+    };
+
+    // An image to be drawn with get_image(), looked up once instead of every frame. Only
+    // use handles on the UI thread.
+    struct Handle {
+        std::uint32_t index = 0;
+        // 0 is never a valid generation.
+        std::uint32_t generation = 0;
+    };
+
     void initialize(SDL_Renderer *renderer);
 
     void finalize();
 
+    // Call this once per frame, on the UI thread.
+    void new_frame();
+
+    // What was uploaded to the GPU during the previous frame.
+    UploadStats get_upload_stats();
+
+    // Maximum amount of memory used by decoded images, in bytes.
+    void set_cache_budget(std::size_t bytes);
+
+    // The location is a http(s) URL, or a local file: "file://" and absolute paths are
+    // read from the SD card, "ui/..." from the app's content. A local file that doesn't
+    // exist is drawn as the placeholder.
     SDL_Texture *get(const std::string& location);
+
+    // Like get(), but the image is downscaled to fit inside width x height when decoded.
+    SDL_Texture *get(const std::string& location, float width, float height);
+
+    // Like get(), for an image available in several resolutions, sorted from smallest to
+    // largest. The smallest loaded one is shown while a larger one loads; how large
+    // depends on the draw size, and on how fast downloads have been.
+    SDL_Texture *get(const std::vector<Variant>& variants, float width, float height);
+
+    // Like get(), but 426x240 and 320x180 images are packed into shared atlas
+    // textures; draw it with the returned UVs.
+    Image get_image(const std::string& location, float width, float height);
+
+    // Makes a handle for get_image(location, width, height); it stays valid until
+    // released. Loading starts when it's first drawn.
+    Handle make_handle(const std::string& location, float width, float height);
+
+    void release(Handle handle);
+
+    // Like get_image(), without hashing the location or taking any lock.
+    Image get_image(Handle handle);
+
+    // Starts loading an image for a later get_image(), behind the ones being drawn.
+    void prefetch(const std::string& location, float width, float height);
+
+    // Hands over the encoded bytes of a recently downloaded image, if they're still kept.
+    std::optional<std::vector<char>> take_encoded(const std::string& location);
+
+    // Drops what's loaded from location, so it's loaded again the next time it's drawn,
+    // e.g. after the file was written. Thread-safe.
+    void forget(const std::string& location);
+
+    // Thread-safe.
+    void clear_disk_cache();
 }
\ No newline at end of file
@@ -7,16 +7,32 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
 #include <ranges>
+#include <span>
 #include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <glaze/glaze.hpp>
 
 #include "ThemezerAPI.h"
+#include "disk_cache.hpp"
 #include "graphql.h"
+#include "thread_safe.hpp"
 #include "tracer.hpp"
+#include "utils.h"
 
 using std::cout;
 using std::cerr;
@@ -46,31 +62,282 @@ namespace ThemezerAPI {
 
     const std::string url = "https://api.themezer.net/graphql";
 
-    bool busy;
+    // What theme() and themes_by_id() ask for, for each theme.
+    const std::string theme_fields = R"({
+      uuid
+      hexId
+      quickId
+      slug
+      name
+      createdAt
+      updatedAt
+      creator {
+        username
+        avatarUrl
+      }
+      bgmPreviewUrl
+      collagePreview {
+        tinyUrl
+        thumbUrl
+        sdUrl
+        hdUrl
+      }
+      launcherScreenshot {
+        tinyUrl
+        thumbUrl
+        sdUrl
+        hdUrl
+      }
+      waraWaraPlazaScreenshot {
+        tinyUrl
+        thumbUrl
+        sdUrl
+        hdUrl
+      }
+      downloadCount
+      downloadUrl
+      tags {
+        name
+      }
+    })";
+
+    // What themes() and themes_uncached() ask for.
+    const std::string themes_query = R"(
+query Themes($order: SortOrder, $paginationArgs: PaginationInput, $query: String, $sort: ItemSort) {
+  wiiu {
+    themes(order: $order, paginationArgs: $paginationArgs, query: $query, sort: $sort) {
+      pageInfo {
+        itemCount
+        limit
+        page
+        pageCount
+      }
+      nodes {
+        uuid
+        hexId
+        name
+        slug
+        creator {
+          username
+        }
+        collagePreview {
+          thumbUrl
+        }
+        downloadCount
+        downloadUrl
+        createdAt
+        updatedAt
+      }
+    }
+  }
+}
+)";
+
+    // Responses are kept here, and the last ones on the SD card, so a page seen before is
+    // shown right away; one older than fresh_seconds is also fetched again, and the
+    // callback runs a second time if it changed. Only the UI thread touches memory_cache;
+    // the SD card is only read by disk_loader, and written by the network thread.
+    const std::int64_t fresh_seconds = 5 * 60;
+    // Room for a few pages, and the details of the themes on them.
+    const std::size_t max_memory_entries = 64;
+    const std::uint64_t max_disk_cache_bytes = 1024 * 1024;
+
+    struct CachedResponse {
+        // The whole response body.
+        std::string body;
+        // What body decodes to, so a hit doesn't parse it again on the UI thread; only
+        // entries read back from the SD card don't have it yet.
+        std::shared_ptr<const void> decoded;
+        // Seconds since the epoch.
+        std::int64_t stored_at = 0;
+    };
+
+    std::map<std::string, CachedResponse> memory_cache;
+    std::optional<disk_cache> disk;
+
+    // Reads the SD card copy at startup; process() moves what it read into memory_cache.
+    std::jthread disk_loader;
+    thread_safe<std::vector<std::pair<std::string, CachedResponse>>> loaded_from_disk;
+
+    // The "data" member of responses is read straight into these.
+    struct ThemesData {
+        struct {
+            struct {
+                PageInfo pageInfo;
+                WiiuThemeSmallVec nodes;
+            } themes;
+        } wiiu;
+    };
+
+    struct ThemeData {
+        struct {
+            std::optional<WiiuThemeFull> theme;
+        } wiiu;
+    };
+
+    // The theme() selections of a batch are aliased t0, t1, ...
+    struct ThemeBatchData {
+        std::map<std::string, std::optional<WiiuThemeFull>> wiiu;
+    };
+
+    template<typename T>
+    using handler_t = std::function<void(const T& data)>;
+
+    // A request being sent, and the calls that want its response.
+    template<typename T>
+    struct Pending {
+        std::uint64_t id = 0;
+        handler_t<T> handler;
+        // The cached body it was called with already, if any.
+        std::optional<std::string> served;
+    };
+
+    template<typename T>
+    struct InFlight {
+        graphql::token token;
+        std::vector<Pending<T>> waiters;
+        // The batch the request belongs to, if any; its token is shared with the other
+        // themes in it, so it's only canceled with its themes_by_id() call.
+        std::uint64_t batch = 0;
+    };
+
+    // By cache key.
+    template<typename T>
+    std::map<std::string, InFlight<T>> in_flight;
+
+    // A call waiting for a request.
+    struct Waiter {
+        std::string key;
+        std::uint64_t id = 0;
+        void (*cancel)(const Waiter& waiter) = nullptr;
+    };
+    std::uint64_t next_waiter_id = 1;
+
+    // The pending call of each category, so a newer one can cancel it.
+    std::array<std::optional<Waiter>, static_cast<std::size_t>(Category::lookup) + 1> latest;
+
+    // A themes_by_id() call waiting for its batches.
+    struct BatchCall {
+        wiiu::themes_by_id_function_t callback;
+        std::vector<std::string> ids;
+        // By ID.
+        std::map<std::string, std::shared_ptr<const ThemeData>> results;
+        // By batch.
+        std::map<std::uint64_t, graphql::token> requests;
+    };
+    // By waiter ID.
+    std::map<std::uint64_t, std::shared_ptr<BatchCall>> batch_calls;
+    std::uint64_t next_batch = 1;
+
+    template<typename T>
+    void cancel_all()
+    {
+        for (auto& [key, request] : in_flight<T>)
+            request.token.cancel();
+        in_flight<T>.clear();
+    }
+
+    void load_disk_cache(std::stop_token token)
+    {
+        auto keys = disk->keys();
+        if (keys.size() > max_memory_entries)
+            keys.resize(max_memory_entries);
+
+        // Oldest first, so reading them keeps their order.
+        for (auto& key : keys | std::views::reverse) {
+            if (token.stop_requested())
+                break;
+
+            auto meta = disk->lookup(key);
+            auto data = disk->read(key);
+            if (!meta || !data)
+                continue;
+
+            CachedResponse entry;
+            entry.body.assign(data->begin(), data->end());
+            entry.stored_at = meta->stored_at;
+            loaded_from_disk.lock()->emplace_back(key, std::move(entry));
+        }
+    }
 
     void initialize(const std::string& user_agent)
     {
         TRACE_FUNC;
 
         graphql::initialize(user_agent);
-        busy = false;
+
+        try {
+            disk.emplace(THEMIIFY_HTTP_CACHE / "themezer", max_disk_cache_bytes);
+            disk_loader = std::jthread{load_disk_cache};
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: ThemezerAPI::initialize(): disk cache disabled: " << e.what() << endl;
+        }
     }
 
     void finalize()
     {
         TRACE_FUNC;
 
+        for (auto& waiter : latest)
+            waiter.reset();
+        cancel_all<ThemesData>();
+        cancel_all<ThemeData>();
+        for (auto& [id, call] : batch_calls)
+            for (auto& [batch, token] : call->requests)
+                token.cancel();
+        batch_calls.clear();
+
         graphql::finalize();
-        busy = true;
+
+        disk_loader = {};
+        loaded_from_disk.lock()->clear();
+        memory_cache.clear();
+        disk.reset();
     }
 
-    bool is_busy()
+    void clear_disk_cache()
     {
-        return busy;
+        if (disk)
+            disk->clear();
     }
 
+    namespace {
+
+        void trim_memory_cache();
+
+        // Runs on the network thread; the SD card is slow, so the UI thread never writes
+        // to it. An unchanged response only gets its time updated.
+        void store_on_disk(const std::string& key,
+                           const std::string& body,
+                           bool unchanged)
+        {
+            if (!disk)
+                return;
+
+            if (unchanged) {
+                disk->refresh(key, fresh_seconds);
+                return;
+            }
+
+            disk_cache::metadata meta;
+            meta.max_age = fresh_seconds;
+            disk->store(key, std::span{body}, meta);
+        }
+
+    } // namespace
+
     void process()
     {
+        std::vector<std::pair<std::string, CachedResponse>> loaded;
+        loaded_from_disk.lock()->swap(loaded);
+
+        // A response that arrived in the meantime is newer.
+        for (auto& [key, entry] : loaded)
+            memory_cache.try_emplace(key, std::move(entry));
+        if (!loaded.empty())
+            trim_memory_cache();
+
         graphql::process();
     }
 
@@ -78,8 +345,6 @@ namespace ThemezerAPI {
 
         void common_errors_handler(const glz::generic& errors)
         {
-            busy = false;
-
             auto msg = glz::write<glz::opts{.prettify = true}>(errors)
                              .value_or("error")
                              .c_str();
@@ -88,183 +353,607 @@ namespace ThemezerAPI {
 
         void common_exception_handler(const std::exception& error)
         {
-            busy = false;
-
             cerr << "ERROR: " << error.what() << endl;
         }
 
-    } // namespace
+        void trim_memory_cache()
+        {
+            while (memory_cache.size() > max_memory_entries) {
+                auto oldest = std::ranges::min_element(memory_cache,
+                                                       {},
+                                                       [](auto& kv) { return kv.second.stored_at; });
+                memory_cache.erase(oldest);
+            }
+        }
 
-    void wiiu::themes(const ThemesSpec& spec,
-                      themes_function_t callback)
-    {
-        TRACE_FUNC;
+        std::optional<CachedResponse> find_cached(const std::string& key)
+        {
+            if (auto it = memory_cache.find(key); it != memory_cache.end())
+                return it->second;
+            return {};
+        }
 
-        if (busy) {
-            cerr << "ERROR: ThemezerAPI is busy" << endl;
-            return;
+        // The network thread stored it on the SD card already.
+        void store_cached(const std::string& key,
+                          std::string body,
+                          std::shared_ptr<const void> decoded)
+        {
+            auto& entry = memory_cache[key];
+            entry.body = std::move(body);
+            entry.decoded = std::move(decoded);
+            entry.stored_at = disk_cache::now();
+
+            trim_memory_cache();
         }
 
-        const std::string query = R"(
-query Themes($order: SortOrder, $paginationArgs: PaginationInput, $query: String, $sort: ItemSort) {
-  wiiu {
-    themes(order: $order, paginationArgs: $paginationArgs, query: $query, sort: $sort) {
-      pageInfo {
-        itemCount
-        limit
-        page
-        pageCount
-      }
-      nodes {
-        uuid
-        hexId
-        name
-        slug
-        creator {
-          username
+        template<typename T>
+        void cancel_waiter(const Waiter& waiter)
+        {
+            auto it = in_flight<T>.find(waiter.key);
+            if (it == in_flight<T>.end())
+                return;
+
+            auto& waiters = it->second.waiters;
+            std::erase_if(waiters, [&waiter](auto& w) { return w.id == waiter.id; });
+
+            // Nobody else wants it.
+            if (waiters.empty() && !it->second.batch) {
+                it->second.token.cancel();
+                in_flight<T>.erase(it);
+            }
         }
-        collagePreview {
-          thumbUrl
+
+        // What the cache keeps of a response: glaze's encoding of its data alone, so the
+        // same data compares equal however the server formatted it, and whether it came
+        // from theme() or a themes_by_id() batch.
+        template<typename T>
+        std::string encode_cached(graphql::response<T>& response)
+        {
+            graphql::response<T> data_only;
+            data_only.data = std::move(response.data);
+            auto body = glz::write_json(data_only);
+            response.data = std::move(data_only.data);
+
+            if (!body)
+                throw std::runtime_error{"glz::write_json() failed: "
+                                         + glz::format_error(body.error())};
+            return std::move(*body);
         }
-        downloadCount
-        downloadUrl
-      }
-    }
-  }
-}
-)";
 
-        std::string variables_json;
-        if (auto error = glz::write_json(spec, variables_json))
-            throw std::runtime_error{"glz::write_json() failed: "
-                                     + glz::format_error(error)};
+        // Returns null if the cached body has no data.
+        template<typename T>
+        std::shared_ptr<const T> decode_cached(const std::string& key, const CachedResponse& cached)
+        {
+            // Keys of different types never collide.
+            if (auto data = std::static_pointer_cast<const T>(cached.decoded))
+                return data;
+
+            auto response = graphql::decode<T>(cached.body);
+            if (!response.data)
+                return {};
+
+            auto data = std::make_shared<const T>(std::move(*response.data));
+            if (auto it = memory_cache.find(key); it != memory_cache.end())
+                it->second.decoded = data;
+            return data;
+        }
 
-        auto data_handler = [callback = std::move(callback)](const glz::generic& data) mutable
+        // Calls handler with the cached data right away, if there is any, and with the
+        // response when it arrives, unless that's what it got from the cache. A query
+        // that's already in flight isn't sent again, the handler just waits for the same
+        // response.
+        template<typename T>
+        graphql::token cached_query(const std::string& key,
+                                    const std::string& query,
+                                    const std::string& variables_json,
+                                    handler_t<T> handler,
+                                    Category category)
         {
-            busy = false;
+            // Even a cached answer makes the pending one outdated.
+            std::optional<Waiter>* slot = nullptr;
+            if (category != Category::none) {
+                slot = &latest[static_cast<std::size_t>(category)];
+                if (*slot)
+                    (*slot)->cancel(**slot);
+                slot->reset();
+            }
 
-            auto& wiiu_obj = data.at("wiiu");
-            auto& themes_obj = wiiu_obj.at("themes");
+            std::optional<std::string> cached_body;
+
+            if (auto cached = find_cached(key)) {
+                try {
+                    auto data = decode_cached<T>(key, *cached);
+                    if (!data)
+                        throw std::runtime_error{"no data"};
+                    handler(*data);
+                    cached_body = std::move(cached->body);
+
+                    if (disk_cache::now() - cached->stored_at < fresh_seconds)
+                        return {};
+                }
+                catch (std::exception& e) {
+                    cerr << "WARNING: ThemezerAPI: ignoring cached " << key << ": " << e.what() << endl;
+                }
+            }
 
-            auto& nodes = themes_obj.at("nodes").get<glz::generic::array_t>();
-            WiiuThemeSmallVec themes(nodes.size());
+            const std::uint64_t id = next_waiter_id++;
+            if (slot)
+                *slot = Waiter{key, id, cancel_waiter<T>};
+
+            // A token canceled by its caller won't finish.
+            if (auto it = in_flight<T>.find(key); it != in_flight<T>.end()) {
+                if (it->second.token.is_pending()) {
+                    it->second.waiters.push_back({id, std::move(handler), std::move(cached_body)});
+                    return it->second.token;
+                }
+                in_flight<T>.erase(it);
+            }
 
-#ifdef __cpp_lib_ranges_zip
-            for (auto [theme, node] : std::views::zip(themes, nodes)) {
-                if (auto error = glz::read_json(theme, node))
-                    throw std::runtime_error{"glz::read_json() failed: "
-                                             + glz::format_error(error)};
+            // Something is on screen already, so errors of a revalidation are only logged.
+            const bool revalidating = cached_body.has_value();
+
+            // The response was decoded on the worker thread already.
+            auto response_func = [key, revalidating]
+                (graphql::response<T>& response, const std::string& body)
+            {
+                auto it = in_flight<T>.find(key);
+                if (it == in_flight<T>.end())
+                    return;
+                auto waiters = std::move(it->second.waiters);
+                in_flight<T>.erase(it);
+
+                if (response.errors) {
+                    if (revalidating)
+                        cerr << "WARNING: ThemezerAPI: could not revalidate " << key << endl;
+                    else
+                        common_errors_handler(*response.errors);
+                }
+
+                if (!response.data)
+                    return;
+
+                auto data = std::make_shared<const T>(std::move(*response.data));
+                store_cached(key, body, data);
+
+                for (auto& waiter : waiters) {
+                    // It has this already.
+                    if (waiter.served == body)
+                        continue;
+                    try {
+                        waiter.handler(*data);
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: ThemezerAPI: " << key << ": " << e.what() << endl;
+                    }
+                }
+            };
+
+            auto exception_func = [key, revalidating](const std::exception& error)
+            {
+                in_flight<T>.erase(key);
+                if (revalidating)
+                    cerr << "WARNING: ThemezerAPI: could not revalidate "
+                         << key << ": " << error.what() << endl;
+                else
+                    common_exception_handler(error);
+            };
+
+            auto parse = [key,
+                          cached_body,
+                          response_func = std::move(response_func)]
+                (const std::string& json) mutable -> graphql::deliver_function_t
+            {
+                auto response = graphql::decode<T>(json);
+                std::string body;
+                if (response.data) {
+                    body = encode_cached(response);
+                    store_on_disk(key, body, body == cached_body);
+                }
+
+                return [response = std::move(response),
+                        body = std::move(body),
+                        response_func = std::move(response_func)]
+                    (const std::string&) mutable
+                {
+                    response_func(response, body);
+                };
+            };
+
+            auto token = graphql::get_async_parsed(url,
+                                                   query,
+                                                   variables_json,
+                                                   std::move(parse),
+                                                   std::move(exception_func));
+
+            auto& entry = in_flight<T>[key];
+            entry.token = token;
+            entry.waiters.push_back({id, std::move(handler), std::move(cached_body)});
+
+            return token;
+        }
+
+        // The themes_by_id() call was canceled; its requests keep going if theme() calls
+        // are waiting for them.
+        void cancel_batch_call(const Waiter& waiter)
+        {
+            auto it = batch_calls.find(waiter.id);
+            if (it == batch_calls.end())
+                return;
+            auto call = std::move(it->second);
+            batch_calls.erase(it);
+
+            for (auto& [batch, token] : call->requests) {
+                auto in_batch = [batch](auto& kv) { return kv.second.batch == batch; };
+                bool wanted = std::ranges::any_of(in_flight<ThemeData>,
+                                                  [&in_batch](auto& kv)
+                                                  {
+                                                      return in_batch(kv) && !kv.second.waiters.empty();
+                                                  });
+                if (wanted)
+                    continue;
+                token.cancel();
+                std::erase_if(in_flight<ThemeData>, in_batch);
             }
-#else
-            for (std::size_t i = 0; i < nodes.size(); ++i) {
-                if (auto error = glz::read_json(themes[i], nodes[i]))
-                    throw std::runtime_error{"glz::read_json() failed: "
-                                             + glz::format_error(error)};
+        }
+
+        void finish_batch_call(BatchCall& call)
+        {
+            std::vector<WiiuThemeFull> themes;
+            for (auto& id : call.ids) {
+                auto it = call.results.find(id);
+                if (it != call.results.end() && it->second && it->second->wiiu.theme)
+                    themes.push_back(*it->second->wiiu.theme);
+            }
+
+            try {
+                if (call.callback)
+                    call.callback(themes);
             }
-#endif
+            catch (std::exception& e) {
+                cerr << "ERROR: ThemezerAPI::wiiu::themes_by_id(): " << e.what() << endl;
+            }
+        }
+
+        // One theme of a batch response, decoded and encoded as if theme() got it.
+        struct BatchItem {
+            std::string id;
+            std::shared_ptr<const ThemeData> data;
+            std::string body;
+        };
 
-            PageInfo pageInfo;
-            if (auto error = glz::read_json(pageInfo, themes_obj.at("pageInfo")))
-                throw std::runtime_error{"glz::read_json() failed: "
+        // Runs on the UI thread, when a batch arrives.
+        void finish_batch(std::uint64_t call_id,
+                          std::uint64_t batch,
+                          std::vector<BatchItem>& items)
+        {
+            std::shared_ptr<BatchCall> call;
+            if (auto it = batch_calls.find(call_id); it != batch_calls.end())
+                call = it->second;
+
+            for (auto& item : items) {
+                const std::string key = "theme:" + item.id;
+
+                std::vector<Pending<ThemeData>> waiters;
+                if (auto it = in_flight<ThemeData>.find(key);
+                    it != in_flight<ThemeData>.end() && it->second.batch == batch) {
+                    waiters = std::move(it->second.waiters);
+                    in_flight<ThemeData>.erase(it);
+                }
+
+                if (call)
+                    call->results[item.id] = item.data;
+
+                for (auto& waiter : waiters) {
+                    // It has this already.
+                    if (waiter.served == item.body)
+                        continue;
+                    try {
+                        waiter.handler(*item.data);
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: ThemezerAPI: " << key << ": " << e.what() << endl;
+                    }
+                }
+
+                store_cached(key, std::move(item.body), item.data);
+            }
+
+            // Themes missing from the response.
+            std::erase_if(in_flight<ThemeData>, [batch](auto& kv) { return kv.second.batch == batch; });
+
+            if (!call)
+                return;
+            call->requests.erase(batch);
+            if (call->requests.empty()) {
+                batch_calls.erase(call_id);
+                finish_batch_call(*call);
+            }
+        }
+
+        std::string trim(const std::string& s)
+        {
+            auto is_space = [](unsigned char c) { return std::isspace(c); };
+            auto first = std::ranges::find_if_not(s, is_space);
+            auto last = std::ranges::find_if_not(s | std::views::reverse, is_space).base();
+            if (first >= last)
+                return {};
+            return {first, last};
+        }
+
+        // IDs that only differ in case are the same.
+        std::string normalize_id(const std::string& hexId)
+        {
+            std::string result = hexId;
+            std::ranges::transform(result, result.begin(),
+                                   [](unsigned char c) { return std::tolower(c); });
+            return result;
+        }
+
+        std::string make_batch_query(std::size_t count)
+        {
+            std::string query = "\nquery(";
+            for (std::size_t i = 0; i < count; ++i) {
+                if (i)
+                    query += ", ";
+                query += "$id" + std::to_string(i) + ": String!";
+            }
+            query += ") {\n  wiiu {\n";
+            for (std::size_t i = 0; i < count; ++i) {
+                auto n = std::to_string(i);
+                query += "    t" + n + ": theme(hexId: $id" + n + ") " + theme_fields + "\n";
+            }
+            query += "  }\n}\n";
+            return query;
+        }
+
+        std::string themes_variables(const wiiu::ThemesSpec& spec)
+        {
+            // Searches that only differ in surrounding spaces are the same.
+            wiiu::ThemesSpec normalized = spec;
+            normalized.query = trim(spec.query);
+
+            std::string variables_json;
+            if (auto error = glz::write_json(normalized, variables_json))
+                throw std::runtime_error{"glz::write_json() failed: "
                                          + glz::format_error(error)};
+            return variables_json;
+        }
+
+    } // namespace
+
+    graphql::token wiiu::themes(const ThemesSpec& spec,
+                                themes_function_t callback,
+                                Category category)
+    {
+        TRACE_FUNC;
+
+        const std::string variables_json = themes_variables(spec);
+
+        auto shared_callback = std::make_shared<themes_function_t>(std::move(callback));
+
+        auto data_handler = [shared_callback](const ThemesData& data)
+        {
+            auto& callback = *shared_callback;
+            auto& themes = data.wiiu.themes;
 
             if (callback)
-                callback(themes, pageInfo);
+                callback(themes.nodes, themes.pageInfo);
         };
 
-        busy = true;
-
-        graphql::get_async(url,
-                           query,
-                           variables_json,
-                           std::move(data_handler),
-                           common_errors_handler,
-                           common_exception_handler);
+        return cached_query<ThemesData>("themes:" + variables_json,
+                                        themes_query,
+                                        variables_json,
+                                        std::move(data_handler),
+                                        category);
     }
 
-    void wiiu::theme(const std::string& hexId,
-                     theme_function_t callback)
+    graphql::token wiiu::themes_uncached(const ThemesSpec& spec,
+                                         themes_function_t callback)
     {
         TRACE_FUNC;
 
-        if (busy) {
-            cerr << "ERROR: ThemezerAPI is busy" << endl;
-            return;
-        }
+        auto response_func = [callback = std::move(callback)]
+            (graphql::response<ThemesData>& response, const std::string&) mutable
+        {
+            if (response.errors)
+                common_errors_handler(*response.errors);
+
+            if (!response.data)
+                return;
+
+            auto& themes = response.data->wiiu.themes;
+            if (callback)
+                callback(themes.nodes, themes.pageInfo);
+        };
+
+        return graphql::get_async_typed<ThemesData>(url,
+                                                    themes_query,
+                                                    themes_variables(spec),
+                                                    std::move(response_func),
+                                                    common_exception_handler);
+    }
+
+    graphql::token wiiu::theme(const std::string& hexId,
+                               theme_function_t callback,
+                               Category category)
+    {
+        TRACE_FUNC;
 
         const std::string query = R"(
 query($hexId: String!) {
   wiiu {
-    theme(hexId: $hexId) {
-      uuid
-      hexId
-      quickId
-      slug
-      name
-      createdAt
-      updatedAt
-      creator {
-        username
-        avatarUrl
-      }
-      bgmPreviewUrl
-      collagePreview {
-        tinyUrl
-        thumbUrl
-        sdUrl
-        hdUrl
-      }
-      launcherScreenshot {
-        tinyUrl
-        thumbUrl
-        sdUrl
-        hdUrl
-      }
-      waraWaraPlazaScreenshot {
-        tinyUrl
-        thumbUrl
-        sdUrl
-        hdUrl
-      }
-      downloadCount
-      downloadUrl
-      tags {
-        name
-      }
-    }
+    theme(hexId: $hexId) )" + theme_fields + R"(
   }
 }
 )";
 
+        std::string normalized_id = normalize_id(hexId);
+
         glz::generic variables;
-        variables["hexId"] = hexId;
+        variables["hexId"] = normalized_id;
+
+        auto variables_json = glz::write_json(variables);
+        if (!variables_json)
+            throw std::runtime_error{"glz::write_json() failed: "
+                                     + glz::format_error(variables_json.error())};
+
+        auto shared_callback = std::make_shared<theme_function_t>(std::move(callback));
 
-        auto data_handler = [callback = std::move(callback)](const glz::generic& data) mutable
+        auto data_handler = [shared_callback](const ThemeData& data)
         {
             TRACE_FUNC;
 
-            busy = false;
+            auto& callback = *shared_callback;
 
-            auto& wiiu_obj = data.at("wiiu");
-            auto& theme_obj = wiiu_obj.at("theme");
-
-            auto result = glz::read_json<WiiuThemeFull>(theme_obj);
-            if (!result)
-                throw std::runtime_error{"glz::read_json() failed: "s
-                                         + glz::format_error(result.error())};
+            if (!data.wiiu.theme)
+                throw std::runtime_error{"theme not found"};
 
             if (callback)
-                callback(*result);
+                callback(*data.wiiu.theme);
         };
 
-        busy = true;
+        return cached_query<ThemeData>("theme:" + normalized_id,
+                                       query,
+                                       *variables_json,
+                                       std::move(data_handler),
+                                       category);
+    }
+
+    void wiiu::themes_by_id(const std::vector<std::string>& hexIds,
+                            themes_by_id_function_t callback,
+                            Category category)
+    {
+        TRACE_FUNC;
+
+        std::optional<Waiter>* slot = nullptr;
+        if (category != Category::none) {
+            slot = &latest[static_cast<std::size_t>(category)];
+            if (*slot)
+                (*slot)->cancel(**slot);
+            slot->reset();
+        }
+
+        auto call = std::make_shared<BatchCall>();
+        call->callback = std::move(callback);
+
+        std::vector<std::string> missing;
+        for (auto& hexId : hexIds) {
+            auto id = normalize_id(hexId);
+            if (std::ranges::find(call->ids, id) != call->ids.end())
+                continue;
+            call->ids.push_back(id);
+
+            const std::string key = "theme:" + id;
+            if (auto cached = find_cached(key);
+                cached && disk_cache::now() - cached->stored_at < fresh_seconds) {
+                try {
+                    if (auto data = decode_cached<ThemeData>(key, *cached)) {
+                        call->results[id] = std::move(data);
+                        continue;
+                    }
+                }
+                catch (std::exception& e) {
+                    cerr << "WARNING: ThemezerAPI: ignoring cached " << key << ": " << e.what() << endl;
+                }
+            }
+            missing.push_back(id);
+        }
+
+        if (missing.empty()) {
+            finish_batch_call(*call);
+            return;
+        }
+
+        const std::uint64_t call_id = next_waiter_id++;
+
+        for (std::size_t start = 0; start < missing.size(); start += max_batch_size) {
+            const std::size_t count = std::min(max_batch_size, missing.size() - start);
+            std::vector<std::string> ids(missing.begin() + start,
+                                         missing.begin() + start + count);
+
+            glz::generic variables;
+            for (std::size_t i = 0; i < count; ++i)
+                variables["id" + std::to_string(i)] = ids[i];
+
+            auto variables_json = glz::write_json(variables);
+            if (!variables_json)
+                throw std::runtime_error{"glz::write_json() failed: "
+                                         + glz::format_error(variables_json.error())};
+
+            const std::uint64_t batch = next_batch++;
+
+            // What the stale ones were, so the unchanged ones aren't written again.
+            std::map<std::string, std::string> cached_bodies;
+            for (auto& id : ids)
+                if (auto it = memory_cache.find("theme:" + id); it != memory_cache.end())
+                    cached_bodies.emplace(id, it->second.body);
+
+            // Split up on the worker thread, so each theme is cached like theme() does.
+            auto parse = [call_id, batch, ids, cached_bodies = std::move(cached_bodies)]
+                (const std::string& json) -> graphql::deliver_function_t
+            {
+                auto response = graphql::decode<ThemeBatchData>(json);
+
+                std::vector<BatchItem> items;
+                if (response.data) {
+                    for (std::size_t i = 0; i < ids.size(); ++i) {
+                        auto it = response.data->wiiu.find("t" + std::to_string(i));
+                        if (it == response.data->wiiu.end())
+                            continue;
+
+                        graphql::response<ThemeData> single;
+                        single.data.emplace();
+                        single.data->wiiu.theme = std::move(it->second);
+
+                        auto body = encode_cached(single);
+
+                        auto cached = cached_bodies.find(ids[i]);
+                        store_on_disk("theme:" + ids[i],
+                                      body,
+                                      cached != cached_bodies.end() && cached->second == body);
+
+                        items.push_back({ids[i],
+                                         std::make_shared<const ThemeData>(std::move(*single.data)),
+                                         std::move(body)});
+                    }
+                }
+
+                return [call_id, batch, items = std::move(items), errors = std::move(response.errors)]
+                    (const std::string&) mutable
+                {
+                    if (errors)
+                        common_errors_handler(*errors);
+                    finish_batch(call_id, batch, items);
+                };
+            };
+
+            auto exception_func = [call_id, batch](const std::exception& error)
+            {
+                common_exception_handler(error);
+                std::vector<BatchItem> none;
+                finish_batch(call_id, batch, none);
+            };
+
+            auto token = graphql::get_async_parsed(url,
+                                                   make_batch_query(count),
+                                                   *variables_json,
+                                                   std::move(parse),
+                                                   std::move(exception_func));
+
+            call->requests.emplace(batch, token);
+
+            // So theme() calls wait for it, instead of asking again.
+            for (auto& id : ids) {
+                auto& entry = in_flight<ThemeData>["theme:" + id];
+                if (entry.token.is_pending())
+                    continue;
+                entry = {token, {}, batch};
+            }
+        }
 
-        graphql::get_async(url,
-                           query,
-                           variables,
-                           std::move(data_handler),
-                           common_errors_handler,
-                           common_exception_handler);
+        batch_calls.emplace(call_id, std::move(call));
+        if (slot)
+            *slot = Waiter{{}, call_id, cancel_batch_call};
     }
 
 }
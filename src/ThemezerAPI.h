@@ -10,11 +10,14 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
 #include <functional>
 #include <optional>
 #include <string>
 #include <vector>
 
+#include "graphql.h"
+
 namespace ThemezerAPI {
 
     struct PageInfo {
@@ -38,6 +41,8 @@ namespace ThemezerAPI {
         } collagePreview;
         unsigned downloadCount;
         std::string downloadUrl;
+        std::string createdAt;
+        std::string updatedAt;
     }; // struct WiiuThemeSmall
 
     using WiiuThemeSmallVec = std::vector<WiiuThemeSmall>;
@@ -125,9 +130,23 @@ namespace ThemezerAPI {
     process();
 
 
-    /// Return true when there's a pending API call.
-    bool
-    is_busy();
+    /// Any number of requests can be pending, and identical ones are only sent once.
+    /// Starting one cancels the pending call of the same category, if any, so only the
+    /// latest one gets its callback.
+    enum class Category {
+        none, // never canceled
+        page,
+        prefetch,
+        prefetch_details,
+        update_check,
+        details,
+        lookup,
+    };
+
+
+    /// Delete the responses cached on the SD card. Thread-safe.
+    void
+    clear_disk_cache();
 
 
     namespace wiiu {
@@ -148,9 +167,20 @@ namespace ThemezerAPI {
             std::string query = "";
         }; // struct ThemesSpec
 
-        void
+        /// A page seen before is passed to the callback right away; if it's not
+        /// recent, the callback is called again when it changed on the server.
+        /// The token is only pending while a request is in flight; it's shared with
+        /// identical calls, canceling it cancels all of them.
+        graphql::token
         themes(const ThemesSpec& spec,
-               themes_function_t callback);
+               themes_function_t callback,
+               Category category = Category::none);
+
+        /// Like themes(), but always asks Themezer, and leaves the cache alone; for
+        /// walking through every page, which would push everything else out of it.
+        graphql::token
+        themes_uncached(const ThemesSpec& spec,
+                        themes_function_t callback);
 
 
 
@@ -158,9 +188,29 @@ namespace ThemezerAPI {
         using theme_function_t = std::move_only_function<theme_function_sig>;
 
 
-        void
+        /// Cached like themes().
+        graphql::token
         theme(const std::string& hexId,
-              theme_function_t callback);
+              theme_function_t callback,
+              Category category = Category::none);
+
+
+        /// How many themes a single request of themes_by_id() asks for.
+        inline constexpr std::size_t max_batch_size = 20;
+
+        using themes_by_id_function_sig = void (const std::vector<WiiuThemeFull>& themes);
+        using themes_by_id_function_t = std::move_only_function<themes_by_id_function_sig>;
+
+        /// Like calling theme() for each ID, but with one request per max_batch_size
+        /// themes; recent ones come from the cache. Each theme is cached on its own, and
+        /// theme() calls made while the batch is in flight wait for it.
+        /// The callback is called once, with the themes that were found, in the order of
+        /// hexIds; themes from a request that failed are missing. Use a category to
+        /// cancel it.
+        void
+        themes_by_id(const std::vector<std::string>& hexIds,
+                     themes_by_id_function_t callback,
+                     Category category = Category::none);
 
     }
 }
@@ -0,0 +1,543 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "ThemezerCatalog.h"
+#include "tracer.hpp"
+#include "utils.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+using ThemezerAPI::ItemSort;
+using ThemezerAPI::PageInfo;
+using ThemezerAPI::SortOrder;
+using ThemezerAPI::WiiuThemeSmall;
+using ThemezerAPI::WiiuThemeSmallVec;
+
+namespace ThemezerCatalog {
+
+    namespace {
+
+        const std::filesystem::path catalog_path = THEMIIFY_ROOT / "cache/themezer-catalog.bin";
+
+        const std::uint32_t file_magic = 0x54414354; // "TCAT"
+        const std::uint32_t file_version = 1;
+
+        // Themezer may send fewer per page; pageInfo says how many pages there are.
+        const unsigned sync_page_size = 100;
+        // An incremental sync doesn't notice deleted themes.
+        const std::int64_t full_sync_interval = 7 * 24 * 60 * 60;
+
+        // Strings stored back to back; string i is [offsets[i], offsets[i + 1]).
+        struct string_column {
+            std::vector<std::uint32_t> offsets{0};
+            std::string bytes;
+
+            std::size_t size() const noexcept
+            {
+                return offsets.size() - 1;
+            }
+
+            std::string_view operator [](std::size_t i) const noexcept
+            {
+                return std::string_view{bytes}.substr(offsets[i], offsets[i + 1] - offsets[i]);
+            }
+
+            void push_back(std::string_view s)
+            {
+                bytes += s;
+                offsets.push_back(bytes.size());
+            }
+        };
+
+        // One entry per theme in each column.
+        struct columns {
+            string_column hex_ids;
+            string_column uuids;
+            string_column names;
+            string_column slugs;
+            string_column thumb_urls;
+            string_column download_urls;
+            // Indexes into creator_names; most creators made many themes.
+            std::vector<std::uint32_t> creators;
+            std::vector<std::uint32_t> download_counts;
+            // Seconds since the epoch.
+            std::vector<std::uint32_t> created_at;
+            std::vector<std::uint32_t> updated_at;
+
+            string_column creator_names;
+
+            std::size_t size() const noexcept
+            {
+                return hex_ids.size();
+            }
+        };
+
+        // Appends themes to new columns, interning the creator names.
+        struct columns_builder {
+            columns result;
+            std::unordered_map<std::string, std::uint32_t> creator_ids;
+
+            std::uint32_t intern(std::string_view creator)
+            {
+                auto [it, inserted] = creator_ids.try_emplace(std::string{creator},
+                                                              result.creator_names.size());
+                if (inserted)
+                    result.creator_names.push_back(creator);
+                return it->second;
+            }
+
+            void add(const WiiuThemeSmall& theme)
+            {
+                result.hex_ids.push_back(theme.hexId);
+                result.uuids.push_back(theme.uuid);
+                result.names.push_back(theme.name);
+                result.slugs.push_back(theme.slug);
+                result.thumb_urls.push_back(theme.collagePreview.thumbUrl);
+                result.download_urls.push_back(theme.downloadUrl);
+                result.creators.push_back(intern(theme.creator.username));
+                result.download_counts.push_back(theme.downloadCount);
+                result.created_at.push_back(ParseISO8601(theme.createdAt).value_or(0));
+                result.updated_at.push_back(ParseISO8601(theme.updatedAt).value_or(0));
+            }
+
+            void add(const columns& from, std::size_t row)
+            {
+                result.hex_ids.push_back(from.hex_ids[row]);
+                result.uuids.push_back(from.uuids[row]);
+                result.names.push_back(from.names[row]);
+                result.slugs.push_back(from.slugs[row]);
+                result.thumb_urls.push_back(from.thumb_urls[row]);
+                result.download_urls.push_back(from.download_urls[row]);
+                result.creators.push_back(intern(from.creator_names[from.creators[row]]));
+                result.download_counts.push_back(from.download_counts[row]);
+                result.created_at.push_back(from.created_at[row]);
+                result.updated_at.push_back(from.updated_at[row]);
+            }
+        };
+
+        struct file_header {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t count;
+            std::uint32_t num_creators;
+            std::int64_t last_full_sync;
+        };
+
+        columns catalog;
+        std::int64_t last_full_sync = 0;
+
+        // Rows in ascending order, for each sort; built when first needed.
+        std::map<ItemSort, std::vector<std::uint32_t>> sorted;
+
+        bool syncing = false;
+        bool full_sync = false;
+        // Themes updated before this are in the catalog already.
+        std::uint32_t synced_until = 0;
+        unsigned sync_page = 0;
+        graphql::token sync_token;
+        // What the sync got so far, by hexId.
+        std::map<std::string, WiiuThemeSmall> fetched;
+
+        std::int64_t now()
+        {
+            using namespace std::chrono;
+            return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        std::string format_time(std::uint32_t t)
+        {
+            using namespace std::chrono;
+            sys_seconds time{seconds{t}};
+            auto days = floor<std::chrono::days>(time);
+            year_month_day date{days};
+            hh_mm_ss hms{time - days};
+
+            char buf[32];
+            std::snprintf(buf, sizeof buf, "%04d-%02u-%02uT%02d:%02d:%02dZ",
+                          static_cast<int>(date.year()),
+                          static_cast<unsigned>(date.month()),
+                          static_cast<unsigned>(date.day()),
+                          static_cast<int>(hms.hours().count()),
+                          static_cast<int>(hms.minutes().count()),
+                          static_cast<int>(hms.seconds().count()));
+            return buf;
+        }
+
+        WiiuThemeSmall make_theme(std::size_t row)
+        {
+            WiiuThemeSmall theme;
+            theme.uuid = catalog.uuids[row];
+            theme.hexId = catalog.hex_ids[row];
+            theme.name = catalog.names[row];
+            theme.slug = catalog.slugs[row];
+            theme.creator.username = catalog.creator_names[catalog.creators[row]];
+            theme.collagePreview.thumbUrl = catalog.thumb_urls[row];
+            theme.downloadCount = catalog.download_counts[row];
+            theme.downloadUrl = catalog.download_urls[row];
+            theme.createdAt = format_time(catalog.created_at[row]);
+            theme.updatedAt = format_time(catalog.updated_at[row]);
+            return theme;
+        }
+
+        void put(std::string& out, const void* data, std::size_t size)
+        {
+            out.append(static_cast<const char*>(data), size);
+        }
+
+        void put(std::string& out, const std::vector<std::uint32_t>& v)
+        {
+            put(out, v.data(), v.size() * sizeof v[0]);
+        }
+
+        void put(std::string& out, const string_column& column)
+        {
+            put(out, column.offsets);
+            put(out, column.bytes.data(), column.bytes.size());
+        }
+
+        // Reads the columns out of the file contents.
+        struct reader {
+            std::span<const char> data;
+
+            void get(void* dst, std::size_t size)
+            {
+                if (size > data.size())
+                    throw std::runtime_error{"truncated file"};
+                std::memcpy(dst, data.data(), size);
+                data = data.subspan(size);
+            }
+
+            void get(std::vector<std::uint32_t>& v, std::size_t n)
+            {
+                if (n > data.size() / sizeof v[0])
+                    throw std::runtime_error{"truncated file"};
+                v.resize(n);
+                get(v.data(), n * sizeof v[0]);
+            }
+
+            void get(string_column& column, std::size_t n)
+            {
+                get(column.offsets, n + 1);
+                if (column.offsets.front() != 0
+                    || !std::ranges::is_sorted(column.offsets))
+                    throw std::runtime_error{"bad string column"};
+                if (column.offsets.back() > data.size())
+                    throw std::runtime_error{"truncated file"};
+                column.bytes.resize(column.offsets.back());
+                get(column.bytes.data(), column.bytes.size());
+            }
+        };
+
+        void load()
+        {
+            std::ifstream in{catalog_path, std::ios::binary};
+            if (!in)
+                return;
+
+            std::error_code ec;
+            auto file_size = std::filesystem::file_size(catalog_path, ec);
+            if (ec)
+                return;
+
+            // All in one read.
+            std::string contents(file_size, '\0');
+            if (!in.read(contents.data(), contents.size()))
+                throw std::runtime_error{"could not read " + catalog_path.string()};
+
+            reader r{contents};
+
+            file_header header;
+            r.get(&header, sizeof header);
+            if (header.magic != file_magic || header.version != file_version)
+                throw std::runtime_error{"unknown format"};
+
+            columns result;
+            const std::size_t n = header.count;
+            r.get(result.hex_ids, n);
+            r.get(result.uuids, n);
+            r.get(result.names, n);
+            r.get(result.slugs, n);
+            r.get(result.thumb_urls, n);
+            r.get(result.download_urls, n);
+            r.get(result.creators, n);
+            r.get(result.download_counts, n);
+            r.get(result.created_at, n);
+            r.get(result.updated_at, n);
+            r.get(result.creator_names, header.num_creators);
+
+            for (auto creator : result.creators)
+                if (creator >= header.num_creators)
+                    throw std::runtime_error{"bad creator index"};
+
+            catalog = std::move(result);
+            last_full_sync = header.last_full_sync;
+        }
+
+        void save()
+        {
+            file_header header{};
+            header.magic = file_magic;
+            header.version = file_version;
+            header.count = catalog.size();
+            header.num_creators = catalog.creator_names.size();
+            header.last_full_sync = last_full_sync;
+
+            std::string contents;
+            put(contents, &header, sizeof header);
+            put(contents, catalog.hex_ids);
+            put(contents, catalog.uuids);
+            put(contents, catalog.names);
+            put(contents, catalog.slugs);
+            put(contents, catalog.thumb_urls);
+            put(contents, catalog.download_urls);
+            put(contents, catalog.creators);
+            put(contents, catalog.download_counts);
+            put(contents, catalog.created_at);
+            put(contents, catalog.updated_at);
+            put(contents, catalog.creator_names);
+
+            auto temp = catalog_path;
+            temp += ".tmp";
+
+            CreateParentDirectories(catalog_path);
+            {
+                std::ofstream out{temp, std::ios::binary | std::ios::trunc};
+                out.write(contents.data(), contents.size());
+                if (!out.flush())
+                    throw std::runtime_error{"could not write " + temp.string()};
+            }
+
+            // NOTE: rename() on the SD card won't replace an existing file.
+            std::error_code ec;
+            std::filesystem::remove(catalog_path, ec);
+            std::filesystem::rename(temp, catalog_path);
+        }
+
+        void finish_sync()
+        {
+            syncing = false;
+
+            columns_builder builder;
+
+            // A full sync saw every theme; the rest were deleted.
+            if (!full_sync)
+                for (std::size_t row = 0; row < catalog.size(); ++row)
+                    if (!fetched.contains(std::string{catalog.hex_ids[row]}))
+                        builder.add(catalog, row);
+
+            for (auto& [hexId, theme] : fetched)
+                builder.add(theme);
+
+            catalog = std::move(builder.result);
+            if (full_sync)
+                last_full_sync = now();
+
+            cout << "ThemezerCatalog: got " << fetched.size() << " themes, "
+                 << catalog.size() << " total" << endl;
+
+            fetched.clear();
+            sorted.clear();
+
+            try {
+                save();
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR: ThemezerCatalog: " << e.what() << endl;
+            }
+        }
+
+        void fetch_sync_page(unsigned page);
+
+        void on_sync_page(unsigned page,
+                          const WiiuThemeSmallVec& themes,
+                          const PageInfo& page_info)
+        {
+            if (!syncing)
+                return;
+
+            bool reached_synced = false;
+            for (auto& theme : themes) {
+                auto updated = ParseISO8601(theme.updatedAt).value_or(0);
+                if (!full_sync && updated < synced_until) {
+                    reached_synced = true;
+                    continue;
+                }
+                fetched[theme.hexId] = theme;
+            }
+
+            if (reached_synced || themes.empty() || page >= page_info.pageCount)
+                finish_sync();
+            else
+                fetch_sync_page(page + 1);
+        }
+
+        void fetch_sync_page(unsigned page)
+        {
+            sync_page = page;
+
+            // Every page of a full sync would push the pages being browsed out of the cache.
+            sync_token = ThemezerAPI::wiiu::themes_uncached({
+                    .paginationArgs = {
+                        .limit = sync_page_size,
+                        .page = page,
+                    },
+                    .sort = ItemSort::UPDATED,
+                    .order = SortOrder::DESC,
+                },
+                [page](const WiiuThemeSmallVec& themes,
+                       const PageInfo& page_info)
+                {
+                    on_sync_page(page, themes, page_info);
+                });
+        }
+
+        const std::vector<std::uint32_t>& rows_by(ItemSort sort)
+        {
+            if (auto it = sorted.find(sort); it != sorted.end())
+                return it->second;
+
+            const std::vector<std::uint32_t>* keys;
+            switch (sort) {
+                case ItemSort::CREATED:
+                    keys = &catalog.created_at;
+                    break;
+                default:
+                    keys = &catalog.updated_at;
+                    break;
+            }
+
+            auto& rows = sorted[sort];
+            rows.resize(catalog.size());
+            std::iota(rows.begin(), rows.end(), 0);
+            std::ranges::stable_sort(rows, {}, [keys](std::uint32_t row) { return (*keys)[row]; });
+            return rows;
+        }
+
+    } // namespace
+
+    void initialize()
+    {
+        TRACE_FUNC;
+
+        try {
+            load();
+        }
+        catch (std::exception& e) {
+            cerr << "WARNING: ThemezerCatalog: ignoring " << catalog_path << ": " << e.what() << endl;
+            catalog = {};
+            last_full_sync = 0;
+        }
+
+        cout << "ThemezerCatalog: " << catalog.size() << " themes" << endl;
+    }
+
+    void finalize()
+    {
+        TRACE_FUNC;
+
+        sync_token.cancel();
+        syncing = false;
+        fetched.clear();
+        sorted.clear();
+        catalog = {};
+    }
+
+    void process()
+    {
+        // The request failed, no callback will come; the next sync starts over.
+        if (syncing && !sync_token.is_pending()) {
+            cerr << "ERROR: ThemezerCatalog: sync failed on page " << sync_page << endl;
+            syncing = false;
+            fetched.clear();
+        }
+    }
+
+    void sync()
+    {
+        if (syncing)
+            return;
+
+        syncing = true;
+        fetched.clear();
+
+        full_sync = catalog.size() == 0 || now() - last_full_sync > full_sync_interval;
+
+        synced_until = 0;
+        if (!full_sync)
+            for (auto updated : catalog.updated_at)
+                synced_until = std::max(synced_until, updated);
+
+        fetch_sync_page(1);
+    }
+
+    bool is_syncing()
+    {
+        return syncing;
+    }
+
+    std::size_t size()
+    {
+        return catalog.size();
+    }
+
+    bool can_serve(ItemSort sort, const std::string& query)
+    {
+        // Saves aren't stored, and download counts change without an update, so a sync
+        // doesn't see them change; text search is left to Themezer.
+        return catalog.size()
+            && query.empty()
+            && (sort == ItemSort::CREATED || sort == ItemSort::UPDATED);
+    }
+
+    std::pair<WiiuThemeSmallVec, PageInfo> page(ItemSort sort,
+                                                SortOrder order,
+                                                unsigned page,
+                                                unsigned limit)
+    {
+        PageInfo info{};
+        info.page = page;
+        info.limit = limit;
+        info.itemCount = catalog.size();
+        info.pageCount = limit ? (catalog.size() + limit - 1) / limit : 0;
+
+        WiiuThemeSmallVec themes;
+        if (!page || !limit)
+            return {std::move(themes), info};
+
+        auto& rows = rows_by(sort);
+        const std::size_t first = std::size_t(page - 1) * limit;
+        const std::size_t last = std::min<std::size_t>(first + limit, rows.size());
+        for (std::size_t i = first; i < last; ++i) {
+            auto row = order == SortOrder::DESC ? rows[rows.size() - 1 - i] : rows[i];
+            themes.push_back(make_theme(row));
+        }
+
+        return {std::move(themes), info};
+    }
+
+}
@@ -0,0 +1,58 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "ThemezerAPI.h"
+
+// A copy of the Themezer catalog on the SD card, so the theme list can be browsed, sorted
+// and paged without waiting for the network. Each sync only fetches the themes that
+// changed since the last one, newest updates first. Only the UI thread calls these.
+namespace ThemezerCatalog {
+
+    void
+    initialize();
+
+    void
+    finalize();
+
+    void
+    process();
+
+
+    /// Fetch what changed on Themezer since the last sync; does nothing if a sync is
+    /// running already.
+    void
+    sync();
+
+    bool
+    is_syncing();
+
+    std::size_t
+    size();
+
+
+    /// Whether page() can list themes this way: there's no text search, and the sort is
+    /// by creation or update time.
+    bool
+    can_serve(ThemezerAPI::ItemSort sort,
+              const std::string& query);
+
+    /// Pages start at 1, like on Themezer.
+    std::pair<ThemezerAPI::WiiuThemeSmallVec, ThemezerAPI::PageInfo>
+    page(ThemezerAPI::ItemSort sort,
+         ThemezerAPI::SortOrder order,
+         unsigned page,
+         unsigned limit);
+
+}
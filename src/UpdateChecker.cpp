@@ -0,0 +1,344 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <stop_token>
+#include <system_error>
+#include <thread>
+
+#include "UpdateChecker.h"
+#include "DownloadManager.h"
+#include "async_queue.hpp"
+#include "thread_safe.hpp"
+#include "tracer.hpp"
+#include "utils.h"
+#include "screens/ManageThemesScreen.h"
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace UpdateChecker {
+
+    namespace {
+
+        struct Outdated {
+            Installer::installed_theme_data installed;
+            ThemezerAPI::WiiuThemeFull latest;
+        };
+
+        // By themeIDPath.
+        std::map<std::string, Outdated> outdated;
+        // Downloading or reinstalling, by themeIDPath.
+        std::set<std::string> updating;
+
+        bool checking = false;
+        // Only the results of the latest check() are used.
+        unsigned check_generation = 0;
+
+        // The console's clock is in local time, Themezer's is UTC; an update less than a
+        // day newer than the install can't be told apart from a time zone.
+        const std::int64_t time_zone_slack = 24 * 60 * 60;
+
+        struct InstallJob {
+            std::filesystem::path utheme;
+            Installer::installed_theme_data installed;
+            bool was_current = false;
+        };
+
+        struct InstallResult {
+            std::string themeIDPath;
+            // The name may change with the update.
+            std::string themeName;
+            bool was_current = false;
+            bool success = false;
+        };
+
+        // Reinstalls run one at a time, on their own thread.
+        async_queue<InstallJob> install_queue;
+        thread_safe<std::vector<InstallResult>> install_results;
+        std::jthread install_thread;
+
+        void install(std::stop_token& token, const InstallJob& job, InstallResult& result)
+        {
+            Installer::theme_data theme_data;
+            if (!Installer::GetThemeMetadata(job.utheme, &theme_data))
+                throw std::runtime_error{"cannot read the metadata of " + job.utheme.string()};
+
+            Installer::InstallTheme(token,
+                                    job.utheme,
+                                    theme_data,
+                                    {},
+                                    [&result] { result.success = true; },
+                                    [](const std::exception& e)
+                                    {
+                                        cerr << "ERROR: UpdateChecker: " << e.what() << endl;
+                                    });
+
+            if (!result.success)
+                return;
+
+            result.themeName = theme_data.themeName;
+
+            // A new name goes into a new folder.
+            Installer::installed_theme_data now_installed;
+            auto json_path = THEMIIFY_INSTALLED_THEMES / (theme_data.themeIDPath + ".json");
+            if (Installer::GetInstalledThemeMetadata(json_path, &now_installed)
+                && now_installed.installedThemePath != job.installed.installedThemePath)
+                DeletePath(job.installed.installedThemePath);
+        }
+
+        void install_loop(std::stop_token token)
+        {
+            try {
+                for (;;) {
+                    auto job = install_queue.pop();
+
+                    InstallResult result;
+                    result.themeIDPath = job.installed.themeIDPath;
+                    result.themeName = job.installed.themeName;
+                    result.was_current = job.was_current;
+
+                    try {
+                        install(token, job, result);
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: UpdateChecker: " << e.what() << endl;
+                    }
+
+                    install_results.lock()->push_back(std::move(result));
+                }
+            }
+            catch (async_queue_error) {
+                // Stopped.
+            }
+        }
+
+        std::string as_lower_case(std::string s)
+        {
+            std::ranges::transform(s, s.begin(), [](unsigned char c) { return std::tolower(c); });
+            return s;
+        }
+
+        // Themes from Themezer have IDs like "Themezer:1a2b3c".
+        std::optional<std::string> themezer_id(const std::string& themeID)
+        {
+            const std::string prefix = "Themezer:";
+            if (!themeID.starts_with(prefix) || themeID.size() == prefix.size())
+                return {};
+
+            return as_lower_case(themeID.substr(prefix.size()));
+        }
+
+        // When the theme was installed, or last reinstalled.
+        std::optional<std::int64_t> installed_at(const Installer::installed_theme_data& theme)
+        {
+            std::error_code ec;
+            auto time = std::filesystem::last_write_time(THEMIIFY_INSTALLED_THEMES
+                                                         / (theme.themeIDPath + ".json"),
+                                                         ec);
+            if (ec)
+                return {};
+
+            using namespace std::chrono;
+            auto t = file_clock::to_sys(time);
+            return duration_cast<seconds>(t.time_since_epoch()).count();
+        }
+
+        bool is_current(const Installer::installed_theme_data& theme)
+        {
+            return sanitize_element(theme.themeName + " (" + theme.themeIDPath + ")")
+                == Installer::GetCurrentTheme();
+        }
+
+    } // namespace
+
+    void initialize()
+    {
+        TRACE_FUNC;
+
+        install_queue.reset();
+        install_thread = std::jthread{install_loop};
+    }
+
+    void finalize()
+    {
+        TRACE_FUNC;
+
+        install_queue.stop();
+        install_thread = {};
+
+        outdated.clear();
+        updating.clear();
+        install_results.lock()->clear();
+    }
+
+    void process()
+    {
+        std::vector<InstallResult> results;
+        install_results.lock()->swap(results);
+
+        if (results.empty())
+            return;
+
+        for (auto& result : results) {
+            updating.erase(result.themeIDPath);
+
+            if (result.success) {
+                cout << "Updated " << result.themeName << endl;
+                if (result.was_current)
+                    Installer::SetCurrentTheme(result.themeName, result.themeIDPath);
+            }
+        }
+
+        ManageThemesScreen::force_refresh();
+    }
+
+    void check(const std::vector<Installer::installed_theme_data>& installed)
+    {
+        std::vector<std::string> ids;
+        // By Themezer ID.
+        std::map<std::string, Installer::installed_theme_data> by_id;
+
+        for (auto& theme : installed) {
+            auto id = themezer_id(theme.themeID);
+            if (!id)
+                continue;
+            ids.push_back(*id);
+            by_id.emplace(*id, theme);
+        }
+
+        const unsigned generation = ++check_generation;
+
+        if (ids.empty()) {
+            outdated.clear();
+            checking = false;
+            return;
+        }
+
+        checking = true;
+
+        ThemezerAPI::wiiu::themes_by_id(
+            ids,
+            [generation, by_id = std::move(by_id)](const std::vector<ThemezerAPI::WiiuThemeFull>& themes)
+            {
+                if (generation != check_generation)
+                    return;
+
+                checking = false;
+                outdated.clear();
+
+                for (auto& latest : themes) {
+                    auto it = by_id.find(as_lower_case(latest.hexId));
+                    if (it == by_id.end())
+                        continue;
+
+                    auto& theme = it->second;
+                    if (updating.contains(theme.themeIDPath))
+                        continue;
+
+                    auto updated = ParseISO8601(latest.updatedAt);
+                    auto installed = installed_at(theme);
+                    if (!updated || !installed)
+                        continue;
+
+                    if (*updated > *installed + time_zone_slack)
+                        outdated.emplace(theme.themeIDPath, Outdated{theme, latest});
+                }
+
+                cout << "UpdateChecker: " << outdated.size() << " outdated themes" << endl;
+            },
+            ThemezerAPI::Category::update_check);
+    }
+
+    bool is_checking()
+    {
+        return checking;
+    }
+
+    Status get_status(const std::string& themeIDPath)
+    {
+        if (updating.contains(themeIDPath))
+            return Status::updating;
+        if (outdated.contains(themeIDPath))
+            return Status::outdated;
+        return Status::up_to_date;
+    }
+
+    std::size_t num_outdated()
+    {
+        return outdated.size();
+    }
+
+    void update(const std::string& themeIDPath)
+    {
+        auto it = outdated.find(themeIDPath);
+        if (it == outdated.end())
+            return;
+
+        auto& latest = it->second.latest;
+
+        InstallJob job;
+        job.utheme = THEMES_ROOT / (latest.slug + ".utheme");
+        job.installed = it->second.installed;
+        job.was_current = is_current(it->second.installed);
+
+        bool added;
+        try {
+            added = DownloadManager::add("Update: " + latest.name,
+                                         latest.downloadUrl,
+                                         latest.collagePreview.thumbUrl,
+                                         job.utheme,
+                                         THEMIIFY_THUMBNAILS / ("Themezer" + latest.hexId + ".webp"),
+                                         [job](const DownloadManager::Info&) mutable
+                                         {
+                                             install_queue.push(std::move(job));
+                                         },
+                                         [themeIDPath](const std::exception& error)
+                                         {
+                                             cerr << "ERROR: UpdateChecker: could not download "
+                                                  << themeIDPath << ": " << error.what() << endl;
+                                             updating.erase(themeIDPath);
+                                         },
+                                         true);
+        }
+        catch (std::exception& e) {
+            // Still outdated, so it can be tried again.
+            cerr << "ERROR: UpdateChecker: could not update " << themeIDPath << ": " << e.what() << endl;
+            return;
+        }
+
+        // Already in the downloads; it won't be reinstalled from here.
+        if (!added)
+            return;
+
+        outdated.erase(it);
+        updating.insert(themeIDPath);
+    }
+
+    void update_all()
+    {
+        std::vector<std::string> ids;
+        for (auto& [themeIDPath, entry] : outdated)
+            ids.push_back(themeIDPath);
+
+        for (auto& themeIDPath : ids)
+            update(themeIDPath);
+    }
+
+}
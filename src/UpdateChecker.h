@@ -0,0 +1,64 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "ThemezerAPI.h"
+#include "installer.h"
+
+// Finds installed themes that were updated on Themezer since they were installed, and
+// reinstalls them. Only the UI thread calls these.
+namespace UpdateChecker {
+
+    enum class Status {
+        up_to_date, // or not from Themezer
+        outdated,
+        updating,
+    };
+
+    void
+    initialize();
+
+    void
+    finalize();
+
+    void
+    process();
+
+
+    /// Look up the installed themes that came from Themezer, with one request for
+    /// every ThemezerAPI::wiiu::max_batch_size of them. The results replace the
+    /// previous ones when they arrive.
+    void
+    check(const std::vector<Installer::installed_theme_data>& installed);
+
+    bool
+    is_checking();
+
+
+    /// By themeIDPath.
+    Status
+    get_status(const std::string& themeIDPath);
+
+    std::size_t
+    num_outdated();
+
+
+    /// Download the new version; it's reinstalled once downloaded.
+    void
+    update(const std::string& themeIDPath);
+
+    void
+    update_all();
+
+}
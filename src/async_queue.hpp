@@ -27,7 +27,8 @@ template<typename T,
 class async_queue {
 
     std::timed_mutex mutex;
-    std::condition_variable empty_cond;
+    // NOTE: std::condition_variable only works with std::mutex.
+    std::condition_variable_any empty_cond;
     Q queue;
     bool should_stop = false;
 
@@ -90,6 +91,7 @@ public:
             return false;
 
         queue.push(std::forward<U>(x));
+        empty_cond.notify_one();
         return true;
     }
 
@@ -0,0 +1,168 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+
+// Recycles receive buffers (std::vector<char>, std::string), so a transfer doesn't
+// reallocate its way up to the final size, and the heap keeps seeing the same few sizes.
+//
+// Capacities are powers of two, from 4 KiB to 4 MiB; larger buffers aren't pooled. A
+// class keeps at most 1 MiB of idle buffers, but always at least one buffer.
+// All member functions are thread-safe.
+template<typename Buffer>
+class buffer_pool {
+
+    static constexpr std::size_t min_class_size = 4 * 1024;
+    static constexpr unsigned num_classes = 11;
+    static constexpr std::size_t max_bytes_per_class = 1024 * 1024;
+
+    std::mutex mutex;
+    std::array<std::vector<Buffer>, num_classes> free_lists;
+    std::size_t max_per_class;
+
+
+    static constexpr
+    std::size_t
+    class_size(unsigned c)
+        noexcept
+    {
+        return min_class_size << c;
+    }
+
+
+    // How many idle buffers class c keeps.
+    std::size_t
+    class_limit(unsigned c)
+        const noexcept
+    {
+        const std::size_t by_bytes = max_bytes_per_class / class_size(c);
+        return std::max<std::size_t>(1, std::min(max_per_class, by_bytes));
+    }
+
+
+    // The smallest class that can hold size bytes; num_classes if none can.
+    static constexpr
+    unsigned
+    class_for(std::size_t size)
+        noexcept
+    {
+        unsigned c = 0;
+        while (c < num_classes && class_size(c) < size)
+            ++c;
+        return c;
+    }
+
+public:
+
+    // The largest buffers that are pooled.
+    static constexpr std::size_t max_pooled_size = class_size(num_classes - 1);
+
+
+    explicit
+    buffer_pool(std::size_t max_per_class = 8) :
+        max_per_class{max_per_class}
+    {
+        // So release() never allocates.
+        for (unsigned c = 0; c < num_classes; ++c)
+            free_lists[c].reserve(class_limit(c));
+    }
+
+
+    buffer_pool(const buffer_pool&) = delete;
+
+
+    // An empty buffer with a capacity of at least min_capacity.
+    [[nodiscard]]
+    Buffer
+    acquire(std::size_t min_capacity = min_class_size)
+    {
+        const unsigned c = class_for(min_capacity);
+
+        Buffer buf;
+
+        if (c >= num_classes) {
+            buf.reserve(min_capacity);
+            return buf;
+        }
+
+        {
+            std::lock_guard guard{mutex};
+            auto& list = free_lists[c];
+            if (!list.empty()) {
+                buf = std::move(list.back());
+                list.pop_back();
+                return buf;
+            }
+        }
+
+        buf.reserve(class_size(c));
+        return buf;
+    }
+
+
+    // Make sure buf can hold min_capacity bytes; if it can't, its contents move into a
+    // larger buffer from the pool, and the old one goes back into the pool.
+    void
+    reserve(Buffer& buf,
+            std::size_t min_capacity)
+    {
+        if (buf.capacity() >= min_capacity)
+            return;
+
+        Buffer larger = acquire(min_capacity);
+        larger.insert(larger.end(), buf.begin(), buf.end());
+        release(std::move(buf));
+        buf = std::move(larger);
+    }
+
+
+    // Give a buffer back; its contents are discarded.
+    void
+    release(Buffer&& buf)
+        noexcept
+    {
+        const std::size_t capacity = buf.capacity();
+        if (capacity < min_class_size || capacity > class_size(num_classes - 1))
+            return;
+
+        // Round down, so every buffer in a class holds at least class_size() bytes.
+        unsigned c = class_for(capacity);
+        if (class_size(c) > capacity)
+            --c;
+
+        buf.clear();
+
+        std::lock_guard guard{mutex};
+        auto& list = free_lists[c];
+        if (list.size() < class_limit(c))
+            list.push_back(std::move(buf));
+    }
+
+
+    void
+    clear()
+        noexcept
+    {
+        std::lock_guard guard{mutex};
+        for (auto& list : free_lists)
+            list.clear();
+    }
+
+}; // class buffer_pool
+
+#endif
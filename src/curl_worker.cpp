@@ -0,0 +1,128 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <iostream>
+#include <stdexcept>
+
+#include "curl_worker.hpp"
+
+
+using std::cerr;
+using std::endl;
+
+
+curl_worker::curl_worker()
+{
+    multi = curl_multi_init();
+    if (!multi)
+        throw std::runtime_error{"curl_multi_init() failed"};
+}
+
+
+curl_worker::~curl_worker()
+    noexcept
+{
+    stop();
+
+    if (multi) {
+        curl_multi_cleanup(multi);
+        multi = nullptr;
+    }
+}
+
+
+CURLM*
+curl_worker::get_multi()
+    const noexcept
+{
+    return multi;
+}
+
+
+void
+curl_worker::start(done_function_t new_done_func)
+{
+    done_func = std::move(new_done_func);
+    tasks.reset();
+    thread = std::jthread{[this](std::stop_token token) { run(token); }};
+}
+
+
+void
+curl_worker::stop()
+{
+    if (!thread.joinable())
+        return;
+
+    thread.request_stop();
+    tasks.stop();
+    curl_multi_wakeup(multi);
+    thread.join();
+}
+
+
+void
+curl_worker::post(task_t task)
+{
+    tasks.push(std::move(task));
+    curl_multi_wakeup(multi);
+}
+
+
+void
+curl_worker::run_tasks()
+{
+    for (;;) {
+        auto task = tasks.try_pop();
+        if (!task) {
+            // Only give up when the queue is really empty; contention means
+            // someone is pushing right now.
+            if (task.error() == async_queue_error::locked)
+                continue;
+            return;
+        }
+
+        try {
+            (*task)();
+        }
+        catch (std::exception& e) {
+            cerr << "ERROR: curl_worker task: " << e.what() << endl;
+        }
+    }
+}
+
+
+void
+curl_worker::run(std::stop_token token)
+{
+    while (!token.stop_requested()) {
+        run_tasks();
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int msgs_left = 0;
+        while (auto* msg = curl_multi_info_read(multi, &msgs_left)) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            try {
+                if (done_func)
+                    done_func(msg);
+            }
+            catch (std::exception& e) {
+                cerr << "ERROR: curl_worker done function: " << e.what() << endl;
+            }
+        }
+
+        // NOTE: a curl_multi_wakeup() that happens before this call is not lost, the
+        // poll returns immediately.
+        curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+    }
+}
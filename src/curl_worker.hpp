@@ -0,0 +1,80 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef CURL_WORKER_HPP
+#define CURL_WORKER_HPP
+
+#include <functional>
+#include <stop_token>
+#include <thread>
+
+#include <curl/curl.h>
+
+#include "async_queue.hpp"
+
+
+// Owns a CURLM handle and a thread that drives it.
+//
+// The thread sleeps in curl_multi_poll() until there is socket activity, or until
+// post() wakes it up with curl_multi_wakeup(). The multi handle must only be touched
+// from tasks given to post(), or from the done function.
+class curl_worker {
+
+public:
+
+    using task_t = std::move_only_function<void ()>;
+    using done_function_t = std::move_only_function<void (CURLMsg* msg)>;
+
+private:
+
+    CURLM* multi = nullptr;
+    done_function_t done_func;
+    async_queue<task_t> tasks;
+    std::jthread thread;
+
+    void
+    run(std::stop_token token);
+
+    void
+    run_tasks();
+
+public:
+
+    curl_worker();
+
+    ~curl_worker()
+        noexcept;
+
+    curl_worker(curl_worker&&) = delete;
+
+
+    // Use this to set options on the multi handle, before start().
+    [[nodiscard]]
+    CURLM*
+    get_multi()
+        const noexcept;
+
+
+    // Launch the thread. done_func is called, from the thread, for every finished transfer.
+    void
+    start(done_function_t done_func);
+
+
+    // Stop and join the thread. The multi handle stays valid until destruction.
+    void
+    stop();
+
+
+    // Run task on the worker thread, as soon as possible.
+    void
+    post(task_t task);
+
+}; // class curl_worker
+
+#endif
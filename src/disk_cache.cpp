@@ -0,0 +1,579 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#include "disk_cache.hpp"
+
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using namespace std::literals;
+
+
+namespace {
+
+    const std::uint32_t record_magic = 0x544d4352; // "TMCR"
+    const std::uint32_t index_magic = 0x544d4349; // "TMCI"
+    const std::uint32_t index_version = 1;
+
+    // How many index changes are allowed to be lost on a crash. Records appended to the
+    // pack are never lost, since the index is rebuilt from them.
+    const unsigned max_unsaved_changes = 32;
+
+
+    struct record_header {
+        std::uint32_t magic;
+        std::uint32_t size;
+        std::int64_t stored_at;
+        std::int64_t max_age;
+        std::uint16_t key_size;
+        std::uint16_t etag_size;
+        std::uint16_t last_modified_size;
+        std::uint16_t reserved;
+    };
+
+
+    struct index_header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint64_t pack_size;
+        std::uint64_t use_counter;
+        std::uint32_t count;
+        std::uint32_t reserved;
+    };
+
+
+    struct index_record {
+        std::uint64_t record_offset;
+        std::uint64_t data_offset;
+        std::uint64_t last_use;
+        std::int64_t stored_at;
+        std::int64_t max_age;
+        std::uint32_t size;
+        std::uint16_t key_size;
+        std::uint16_t etag_size;
+        std::uint16_t last_modified_size;
+        std::uint16_t reserved[3];
+    };
+
+
+    template<typename T>
+    void
+    write_pod(std::ostream& out,
+              const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof value);
+    }
+
+
+    template<typename T>
+    bool
+    read_pod(std::istream& in,
+             T& value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof value));
+    }
+
+
+    bool
+    read_string(std::istream& in,
+                std::string& str,
+                std::size_t size)
+    {
+        str.resize(size);
+        return static_cast<bool>(in.read(str.data(), size));
+    }
+
+
+    std::uint16_t
+    checked_size16(const std::string& str)
+    {
+        if (str.size() > 0xffff)
+            throw std::length_error{"string too long for disk_cache"};
+        return static_cast<std::uint16_t>(str.size());
+    }
+
+
+    void
+    replace_file(const std::filesystem::path& src,
+                 const std::filesystem::path& dst)
+    {
+        // NOTE: rename() on the SD card won't replace an existing file.
+        std::error_code ec;
+        std::filesystem::remove(dst, ec);
+        std::filesystem::rename(src, dst);
+    }
+
+} // namespace
+
+
+disk_cache::disk_cache(const std::filesystem::path& base,
+                       std::uint64_t max_bytes_) :
+    pack_path{base.string() + ".pack"},
+    index_path{base.string() + ".idx"},
+    max_bytes{max_bytes_}
+{
+    create_directories(pack_path.parent_path());
+
+    std::error_code ec;
+    auto file_size = std::filesystem::file_size(pack_path, ec);
+    if (ec)
+        file_size = 0;
+
+    bool index_ok = load_index();
+    if (!index_ok || pack_size > file_size) {
+        entries.clear();
+        pack_size = 0;
+        live_bytes = 0;
+    }
+
+    // Pick up anything appended after the index was saved, and drop a torn record.
+    if (pack_size < file_size)
+        scan_pack(pack_size);
+
+    if (pack_size < file_size)
+        std::filesystem::resize_file(pack_path, pack_size, ec);
+
+    open_pack(false);
+
+    cout << "disk_cache: " << pack_path
+         << ": " << entries.size() << " entries, "
+         << live_bytes << "/" << pack_size << " bytes live"
+         << endl;
+}
+
+
+disk_cache::~disk_cache()
+    noexcept
+{
+    try {
+        std::lock_guard lock{mutex};
+        if (unsaved_changes)
+            save_index();
+    }
+    catch (std::exception& e) {
+        cerr << "ERROR: disk_cache::~disk_cache(): " << e.what() << endl;
+    }
+}
+
+
+void
+disk_cache::open_pack(bool truncate)
+{
+    if (pack.is_open())
+        pack.close();
+
+    auto mode = std::ios::in | std::ios::out | std::ios::binary;
+    if (truncate || !exists(pack_path))
+        mode |= std::ios::trunc;
+
+    pack.open(pack_path, mode);
+    if (!pack)
+        throw std::runtime_error{"could not open "s + pack_path.string()};
+}
+
+
+bool
+disk_cache::load_index()
+{
+    std::ifstream in{index_path, std::ios::binary};
+    if (!in)
+        return false;
+
+    index_header header;
+    if (!read_pod(in, header)
+        || header.magic != index_magic
+        || header.version != index_version)
+        return false;
+
+    pack_size = header.pack_size;
+    use_counter = header.use_counter;
+    live_bytes = 0;
+
+    for (std::uint32_t i = 0; i < header.count; ++i) {
+        index_record rec;
+        if (!read_pod(in, rec))
+            return false;
+
+        std::string key;
+        entry e;
+        if (!read_string(in, key, rec.key_size)
+            || !read_string(in, e.meta.etag, rec.etag_size)
+            || !read_string(in, e.meta.last_modified, rec.last_modified_size))
+            return false;
+
+        e.record_offset = rec.record_offset;
+        e.data_offset = rec.data_offset;
+        e.last_use = rec.last_use;
+        e.meta.stored_at = rec.stored_at;
+        e.meta.max_age = rec.max_age;
+        e.meta.size = rec.size;
+
+        if (e.data_offset + e.meta.size > pack_size)
+            return false;
+
+        live_bytes += e.data_offset - e.record_offset + e.meta.size;
+        entries[std::move(key)] = std::move(e);
+    }
+
+    return true;
+}
+
+
+void
+disk_cache::save_index()
+{
+    pack.flush();
+
+    auto tmp_path = index_path;
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+        if (!out)
+            throw std::runtime_error{"could not open "s + tmp_path.string()};
+
+        index_header header{
+            .magic = index_magic,
+            .version = index_version,
+            .pack_size = pack_size,
+            .use_counter = use_counter,
+            .count = static_cast<std::uint32_t>(entries.size()),
+            .reserved = 0,
+        };
+        write_pod(out, header);
+
+        for (auto& [key, e] : entries) {
+            index_record rec{
+                .record_offset = e.record_offset,
+                .data_offset = e.data_offset,
+                .last_use = e.last_use,
+                .stored_at = e.meta.stored_at,
+                .max_age = e.meta.max_age,
+                .size = e.meta.size,
+                .key_size = checked_size16(key),
+                .etag_size = checked_size16(e.meta.etag),
+                .last_modified_size = checked_size16(e.meta.last_modified),
+                .reserved = {},
+            };
+            write_pod(out, rec);
+            out << key << e.meta.etag << e.meta.last_modified;
+        }
+
+        if (!out.flush())
+            throw std::runtime_error{"could not write "s + tmp_path.string()};
+    }
+
+    replace_file(tmp_path, index_path);
+    unsaved_changes = 0;
+}
+
+
+void
+disk_cache::scan_pack(std::uint64_t start)
+{
+    std::ifstream in{pack_path, std::ios::binary};
+    if (!in)
+        return;
+
+    in.seekg(0, std::ios::end);
+    const std::uint64_t file_size = in.tellg();
+    in.seekg(start);
+
+    std::uint64_t offset = start;
+    for (;;) {
+        record_header header;
+        if (!read_pod(in, header) || header.magic != record_magic)
+            break;
+
+        std::string key;
+        entry e;
+        if (!read_string(in, key, header.key_size)
+            || !read_string(in, e.meta.etag, header.etag_size)
+            || !read_string(in, e.meta.last_modified, header.last_modified_size))
+            break;
+
+        e.record_offset = offset;
+        e.data_offset = offset + sizeof header
+            + header.key_size + header.etag_size + header.last_modified_size;
+        e.meta.stored_at = header.stored_at;
+        e.meta.max_age = header.max_age;
+        e.meta.size = header.size;
+        e.last_use = ++use_counter;
+
+        // Make sure the whole body is there.
+        const std::uint64_t end = e.data_offset + e.meta.size;
+        if (end > file_size)
+            break;
+        in.seekg(end);
+
+        if (auto it = entries.find(key); it != entries.end())
+            live_bytes -= it->second.data_offset - it->second.record_offset + it->second.meta.size;
+        live_bytes += end - offset;
+        entries[std::move(key)] = std::move(e);
+
+        offset = end;
+        ++unsaved_changes;
+    }
+
+    pack_size = offset;
+}
+
+
+void
+disk_cache::append(const std::string& key,
+                   std::span<const char> data,
+                   const metadata& meta)
+{
+    record_header header{
+        .magic = record_magic,
+        .size = static_cast<std::uint32_t>(data.size()),
+        .stored_at = meta.stored_at,
+        .max_age = meta.max_age,
+        .key_size = checked_size16(key),
+        .etag_size = checked_size16(meta.etag),
+        .last_modified_size = checked_size16(meta.last_modified),
+        .reserved = 0,
+    };
+
+    pack.clear();
+    pack.seekp(pack_size);
+    write_pod(pack, header);
+    pack << key << meta.etag << meta.last_modified;
+    pack.write(data.data(), data.size());
+    if (!pack)
+        throw std::runtime_error{"could not write "s + pack_path.string()};
+
+    entry e;
+    e.meta = meta;
+    e.meta.size = header.size;
+    e.record_offset = pack_size;
+    e.data_offset = pack_size + sizeof header
+        + header.key_size + header.etag_size + header.last_modified_size;
+    e.last_use = ++use_counter;
+
+    const std::uint64_t end = e.data_offset + e.meta.size;
+
+    if (auto it = entries.find(key); it != entries.end())
+        live_bytes -= it->second.data_offset - it->second.record_offset + it->second.meta.size;
+    live_bytes += end - pack_size;
+    entries[key] = std::move(e);
+
+    pack_size = end;
+}
+
+
+void
+disk_cache::compact()
+{
+    // Keep the most recently used entries, up to 3/4 of the budget, so compaction
+    // doesn't happen again right away.
+    std::vector<std::pair<const std::string*, entry*>> order;
+    order.reserve(entries.size());
+    for (auto& [key, e] : entries)
+        order.emplace_back(&key, &e);
+    std::ranges::sort(order,
+                      std::ranges::greater{},
+                      [](const auto& p) { return p.second->last_use; });
+
+    auto tmp_path = pack_path;
+    tmp_path += ".tmp";
+
+    std::unordered_map<std::string, entry> new_entries;
+    std::uint64_t new_size = 0;
+
+    {
+        std::ofstream out{tmp_path, std::ios::binary | std::ios::trunc};
+        if (!out)
+            throw std::runtime_error{"could not open "s + tmp_path.string()};
+
+        std::vector<char> buf;
+        for (auto [key, e] : order) {
+            const std::uint64_t record_size = e->data_offset - e->record_offset + e->meta.size;
+            if (new_size + record_size > max_bytes / 4 * 3)
+                break;
+
+            buf.resize(record_size);
+            pack.clear();
+            pack.seekg(e->record_offset);
+            if (!pack.read(buf.data(), buf.size()))
+                continue;
+            out.write(buf.data(), buf.size());
+
+            entry moved = *e;
+            moved.record_offset = new_size;
+            moved.data_offset = new_size + (e->data_offset - e->record_offset);
+            new_entries.emplace(*key, std::move(moved));
+
+            new_size += record_size;
+        }
+
+        if (!out.flush())
+            throw std::runtime_error{"could not write "s + tmp_path.string()};
+    }
+
+    cout << "disk_cache: compacted " << pack_path
+         << " from " << pack_size << " to " << new_size << " bytes"
+         << endl;
+
+    pack.close();
+    replace_file(tmp_path, pack_path);
+
+    entries = std::move(new_entries);
+    pack_size = new_size;
+    live_bytes = new_size;
+
+    open_pack(false);
+    save_index();
+}
+
+
+void
+disk_cache::note_change()
+{
+    if (++unsaved_changes >= max_unsaved_changes)
+        save_index();
+}
+
+
+std::optional<disk_cache::metadata>
+disk_cache::lookup(const std::string& key)
+{
+    std::lock_guard lock{mutex};
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return {};
+
+    it->second.last_use = ++use_counter;
+    return it->second.meta;
+}
+
+
+std::optional<std::vector<char>>
+disk_cache::read(const std::string& key)
+{
+    std::lock_guard lock{mutex};
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return {};
+
+    auto& e = it->second;
+    e.last_use = ++use_counter;
+
+    std::vector<char> data(e.meta.size);
+    pack.clear();
+    pack.seekg(e.data_offset);
+    if (!pack.read(data.data(), data.size())) {
+        cerr << "ERROR: disk_cache::read(): failed to read \"" << key << "\"" << endl;
+        pack.clear();
+        return {};
+    }
+
+    return data;
+}
+
+
+std::vector<std::string>
+disk_cache::keys()
+{
+    std::lock_guard lock{mutex};
+
+    std::vector<const std::pair<const std::string, entry>*> sorted;
+    sorted.reserve(entries.size());
+    for (auto& kv : entries)
+        sorted.push_back(&kv);
+    std::ranges::sort(sorted,
+                      std::ranges::greater{},
+                      [](auto* kv) { return kv->second.last_use; });
+
+    std::vector<std::string> result;
+    result.reserve(sorted.size());
+    for (auto* kv : sorted)
+        result.push_back(kv->first);
+    return result;
+}
+
+
+void
+disk_cache::store(const std::string& key,
+                  std::span<const char> data,
+                  metadata meta)
+{
+    std::lock_guard lock{mutex};
+
+    if (data.size() > max_bytes / 4)
+        return;
+
+    if (!meta.stored_at)
+        meta.stored_at = now();
+
+    append(key, data, meta);
+
+    if (pack_size > max_bytes)
+        compact();
+    else
+        note_change();
+}
+
+
+void
+disk_cache::refresh(const std::string& key,
+                    std::int64_t max_age)
+{
+    std::lock_guard lock{mutex};
+
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return;
+
+    it->second.meta.stored_at = now();
+    it->second.meta.max_age = max_age;
+    note_change();
+}
+
+
+void
+disk_cache::clear()
+{
+    std::lock_guard lock{mutex};
+
+    entries.clear();
+    pack_size = 0;
+    live_bytes = 0;
+    use_counter = 0;
+
+    open_pack(true);
+    save_index();
+}
+
+
+std::int64_t
+disk_cache::now()
+    noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+}
+
+
+bool
+disk_cache::is_fresh(const metadata& meta)
+    noexcept
+{
+    const auto age = now() - meta.stored_at;
+    return age >= 0 && age < meta.max_age;
+}
@@ -0,0 +1,151 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef DISK_CACHE_HPP
+#define DISK_CACHE_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+// A persistent cache of HTTP responses, keyed by URL.
+//
+// All bodies are appended to a single pack file, with an index file next to it, so
+// the SD card doesn't fill up with thousands of tiny files. Replaced entries leave
+// dead space behind, which is reclaimed by compacting the pack once it grows past
+// max_bytes. If the index is lost or stale, it's rebuilt by scanning the pack.
+//
+// All member functions are thread-safe.
+class disk_cache {
+
+public:
+
+    struct metadata {
+        std::string etag;
+        std::string last_modified;
+        // Seconds since the epoch.
+        std::int64_t stored_at = 0;
+        // How long, in seconds, the response can be used without revalidation.
+        std::int64_t max_age = 0;
+        std::uint32_t size = 0;
+    };
+
+private:
+
+    struct entry {
+        metadata meta;
+        std::uint64_t record_offset = 0;
+        std::uint64_t data_offset = 0;
+        std::uint64_t last_use = 0;
+    };
+
+    std::mutex mutex;
+
+    std::filesystem::path pack_path;
+    std::filesystem::path index_path;
+    std::uint64_t max_bytes;
+
+    std::fstream pack;
+    std::uint64_t pack_size = 0;
+    std::uint64_t live_bytes = 0;
+    std::uint64_t use_counter = 0;
+    unsigned unsaved_changes = 0;
+
+    std::unordered_map<std::string, entry> entries;
+
+    void
+    open_pack(bool truncate);
+
+    bool
+    load_index();
+
+    void
+    save_index();
+
+    void
+    scan_pack(std::uint64_t start);
+
+    void
+    append(const std::string& key,
+           std::span<const char> data,
+           const metadata& meta);
+
+    void
+    compact();
+
+    void
+    note_change();
+
+public:
+
+    // Files are named base.pack and base.idx
+    disk_cache(const std::filesystem::path& base,
+               std::uint64_t max_bytes);
+
+    ~disk_cache()
+        noexcept;
+
+    disk_cache(const disk_cache&) = delete;
+
+
+    [[nodiscard]]
+    std::optional<metadata>
+    lookup(const std::string& key);
+
+
+    [[nodiscard]]
+    std::optional<std::vector<char>>
+    read(const std::string& key);
+
+
+    // All keys, the most recently used first.
+    [[nodiscard]]
+    std::vector<std::string>
+    keys();
+
+
+    void
+    store(const std::string& key,
+          std::span<const char> data,
+          metadata meta);
+
+
+    // Mark a cached response as revalidated (e.g. after a 304 Not Modified.)
+    void
+    refresh(const std::string& key,
+            std::int64_t max_age);
+
+
+    void
+    clear();
+
+
+    [[nodiscard]]
+    static
+    std::int64_t
+    now()
+        noexcept;
+
+
+    [[nodiscard]]
+    static
+    bool
+    is_fresh(const metadata& meta)
+        noexcept;
+
+}; // class disk_cache
+
+#endif
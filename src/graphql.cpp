@@ -7,10 +7,12 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <exception>
 #include <iostream>
 #include <optional>
-#include <span>
 #include <map>
 #include <stdexcept>
 #include <memory>
@@ -21,7 +23,9 @@
 #include <glaze/json.hpp>
 
 #include "graphql.h"
-#include "byte_stream.hpp"
+#include "async_queue.hpp"
+#include "buffer_pool.hpp"
+#include "curl_worker.hpp"
 #include "tracer.hpp"
 
 using std::cout;
@@ -33,17 +37,51 @@ namespace graphql {
 
     std::string user_agent;
 
-    static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
-    {
-        auto* stream = static_cast<byte_stream*>(userdata);
-        std::span<const char> data(ptr, size * nmemb);
-        return stream->write(data);
-    }
+    // Response bodies are parsed in place, then the buffers are reused.
+    buffer_pool<std::string> buffers;
+
+    // Themezer's answers are a few KiB; anything past this is aborted.
+    const std::size_t max_response_bytes = buffer_pool<std::string>::max_pooled_size;
 
     struct easy_handle {
         CURL* handle = nullptr;
         curl_slist* headers = nullptr;
         std::string post_data;
+        std::string response;
+
+        // Returning less than total makes curl abort the transfer.
+        static size_t write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+        try {
+            auto* easy = static_cast<easy_handle*>(userdata);
+            const std::size_t total = size * nmemb;
+            auto& response = easy->response;
+
+            if (response.size() + total > max_response_bytes)
+                return 0;
+
+            // Size the buffer from the headers, so it doesn't grow chunk by chunk.
+            if (response.empty()) {
+                curl_off_t length = -1;
+                curl_easy_getinfo(easy->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+                const std::size_t expected = length > 0
+                    ? std::min<std::size_t>(length, max_response_bytes)
+                    : 0;
+                buffers.reserve(response, std::max(total, expected));
+            }
+
+            // No Content-Length, or it was for the compressed body.
+            if (response.size() + total > response.capacity())
+                buffers.reserve(response,
+                                std::min(std::max(response.size() + total, 2 * response.capacity()),
+                                         max_response_bytes));
+
+            response.append(ptr, total);
+            return total;
+        }
+        catch (...) {
+            // Exceptions can't go through curl.
+            return 0;
+        }
 
         easy_handle(const std::string& url)
         {
@@ -65,13 +103,19 @@ namespace graphql {
             curl_easy_setopt(handle, CURLOPT_BUFFERSIZE, 65536L);
             curl_easy_setopt(handle, CURLOPT_TCP_NODELAY, 0L);
             curl_easy_setopt(handle, CURLOPT_FAILONERROR, 1L);
+            curl_easy_setopt(handle, CURLOPT_MAXFILESIZE_LARGE, curl_off_t(max_response_bytes));
 
             if (!user_agent.empty())
                 curl_easy_setopt(handle, CURLOPT_USERAGENT, user_agent.c_str());
+
+            curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_cb);
+            curl_easy_setopt(handle, CURLOPT_WRITEDATA, this);
         }
 
         ~easy_handle()
         {
+            buffers.release(std::move(response));
+
             if (headers)
                 curl_slist_free_all(headers);
 
@@ -84,24 +128,24 @@ namespace graphql {
     };
 
     struct request {
-        status current_status = status::pending;
+        std::atomic<status> current_status = status::pending;
         easy_handle easy;
-        data_function_t data_func;
-        errors_function_t errors_func;
+        parse_function_t parse_func;
         exception_function_t exception_func;
-        byte_stream response;
+
+        // Set by parse() on the worker thread, used by finish() on the UI thread.
+        deliver_function_t deliver_func;
+        std::exception_ptr parse_error;
 
         request(request&&) = delete;
 
         request(const std::string& url,
                 const std::string& query,
                 const glz::generic& variables,
-                data_function_t data_func,
-                errors_function_t errors_func,
+                parse_function_t parse_func,
                 exception_function_t exception_func)
             : easy{url},
-              data_func{std::move(data_func)},
-              errors_func{std::move(errors_func)},
+              parse_func{std::move(parse_func)},
               exception_func{std::move(exception_func)}
         {
             glz::generic post;
@@ -120,8 +164,6 @@ namespace graphql {
             curl_easy_setopt(easy.handle, CURLOPT_POST, 1L);
             curl_easy_setopt(easy.handle, CURLOPT_POSTFIELDS, easy.post_data.c_str());
             curl_easy_setopt(easy.handle, CURLOPT_POSTFIELDSIZE, easy.post_data.size());
-            curl_easy_setopt(easy.handle, CURLOPT_WRITEFUNCTION, write_cb);
-            curl_easy_setopt(easy.handle, CURLOPT_WRITEDATA, &response);
         }
 
         CURL* get_id() const noexcept
@@ -129,59 +171,54 @@ namespace graphql {
             return easy.handle;
         }
 
-        void finish() noexcept
+        // Called on the worker thread, so a large response doesn't make a long frame.
+        void parse() noexcept
         try {
-            current_status = status::finished;
+            // Don't bother, it won't be delivered.
+            if (current_status != status::pending)
+                return;
 
             char* content_type = nullptr;
             curl_easy_getinfo(easy.handle, CURLINFO_CONTENT_TYPE, &content_type);
 
             std::string ct = content_type ? content_type : "";
-            auto response_str = response.read_str();
+            auto& response_str = easy.response;
 
             if (!ct.starts_with("application/json"))
                 throw std::runtime_error{"Content-Type should be application/json, but got \""s
                                          + ct + "\"\ncontent:\n"s + response_str};
 
-            glz::generic parsed;
-            auto error = glz::read_json(parsed, response_str);
+            if (parse_func)
+                deliver_func = parse_func(response_str);
+        }
+        catch (...) {
+            parse_error = std::current_exception();
+        }
 
-            if (error)
-                throw std::runtime_error{"glz::read_json() failed: "
-                                         + glz::format_error(error, response_str)};
+        // Called on the UI thread; a request canceled after its transfer ended is dropped here.
+        void finish() noexcept
+        try {
+            status expected = status::pending;
+            if (!current_status.compare_exchange_strong(expected, status::finished))
+                return;
 
-            if (parsed.contains("data"))
-                on_data(parsed.at("data"));
+            if (parse_error)
+                std::rethrow_exception(parse_error);
 
-            if (parsed.contains("errors"))
-                on_errors(parsed.at("errors"));
+            if (deliver_func)
+                deliver_func(easy.response);
         }
         catch (std::exception& e) {
             on_exception(e);
         }
 
-        void on_data(const glz::generic& data) noexcept
-        try {
-            if (data_func)
-                data_func(data);
-        }
-        catch (std::exception& e) {
-            cerr << "ERROR: request::on_data(): " << e.what() << endl;
-        }
-        catch (...) {
-            cerr << "ERROR: request::on_data() caught an exception!" << endl;
-        }
+        void fail(const std::exception& ex) noexcept
+        {
+            status expected = status::pending;
+            if (!current_status.compare_exchange_strong(expected, status::finished))
+                return;
 
-        void on_errors(const glz::generic& errors) noexcept
-        try {
-            if (errors_func)
-                errors_func(errors);
-        }
-        catch (std::exception& e) {
-            cerr << "ERROR: request::on_errors(): " << e.what() << endl;
-        }
-        catch (...) {
-            cerr << "ERROR: request::on_errors() caught an exception!" << endl;
+            on_exception(ex);
         }
 
         void on_exception(const std::exception& ex) noexcept
@@ -197,76 +234,138 @@ namespace graphql {
         }
     };
 
+    // The parse function of get_async(): a generic tree for each callback.
+    parse_function_t make_generic_parser(data_function_t data_func,
+                                         errors_function_t errors_func)
+    {
+        return [data_func = std::move(data_func),
+                errors_func = std::move(errors_func)](const std::string& body) mutable
+            -> deliver_function_t
+        {
+            glz::generic parsed;
+            if (auto error = glz::read_json(parsed, body))
+                throw std::runtime_error{"glz::read_json() failed: "
+                                         + glz::format_error(error, body)};
+
+            return [data_func = std::move(data_func),
+                    errors_func = std::move(errors_func),
+                    parsed = std::move(parsed)](const std::string&) mutable
+            {
+                if (data_func && parsed.contains("data")) {
+                    try {
+                        data_func(parsed.at("data"));
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: request::on_data(): " << e.what() << endl;
+                    }
+                    catch (...) {
+                        cerr << "ERROR: request::on_data() caught an exception!" << endl;
+                    }
+                }
+
+                if (errors_func && parsed.contains("errors")) {
+                    try {
+                        errors_func(parsed.at("errors"));
+                    }
+                    catch (std::exception& e) {
+                        cerr << "ERROR: request::on_errors(): " << e.what() << endl;
+                    }
+                    catch (...) {
+                        cerr << "ERROR: request::on_errors() caught an exception!" << endl;
+                    }
+                }
+            };
+        };
+    }
+
     struct resources {
-        CURLM* multi = nullptr;
+        // Only accessed from the worker thread.
         std::map<CURL*, std::shared_ptr<request>> requests;
 
+        // Finished and parsed requests, waiting for process() to call their callbacks.
+        async_queue<std::move_only_function<void()>> completions;
+
+        curl_worker worker;
+
         resources()
         {
-            multi = curl_multi_init();
-            if (!multi)
-                throw std::runtime_error{"curl_multi_init() failed"};
-
+            CURLM* multi = worker.get_multi();
             curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, 5L);
             curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, 5L);
+
+            worker.start([this](CURLMsg* msg) { on_done(msg); });
         }
 
         ~resources() noexcept
         {
+            worker.stop();
+
             for (auto& [key, val] : requests) {
                 if (val)
-                    curl_multi_remove_handle(multi, val->easy.handle);
+                    curl_multi_remove_handle(worker.get_multi(), val->easy.handle);
             }
-
-            if (multi)
-                curl_multi_cleanup(multi);
         }
 
         void add(std::shared_ptr<request> req)
         {
             assert(req);
 
-            curl_multi_add_handle(multi, req->easy.handle);
-            requests.emplace(req->get_id(), std::move(req));
+            worker.post([this, req = std::move(req)] mutable
+            {
+                curl_multi_add_handle(worker.get_multi(), req->easy.handle);
+                requests.emplace(req->get_id(), std::move(req));
+            });
         }
 
-        void remove(std::shared_ptr<request>& req)
+        void remove(std::shared_ptr<request> req)
         {
             assert(req);
 
-            curl_multi_remove_handle(multi, req->easy.handle);
-            requests.erase(req->get_id());
+            worker.post([this, req = std::move(req)]
+            {
+                if (requests.erase(req->get_id()))
+                    curl_multi_remove_handle(worker.get_multi(), req->easy.handle);
+            });
         }
 
-        void process()
+        // Runs on the worker thread.
+        void on_done(CURLMsg* msg)
         {
-            int running = 0;
-            curl_multi_perform(multi, &running);
+            CURL* id = msg->easy_handle;
+            CURLcode result = msg->data.result;
 
-            int msgs_left = 0;
-            while (auto* msg = curl_multi_info_read(multi, &msgs_left)) {
-                if (msg->msg != CURLMSG_DONE)
-                    continue;
+            auto it = requests.find(id);
 
-                CURL* id = msg->easy_handle;
-                auto it = requests.find(id);
+            if (it == requests.end()) {
+                cerr << "BUG: finished an unknown handle!" << endl;
+                return;
+            }
 
-                if (it == requests.end()) {
-                    cerr << "BUG: finished an unknown handle!" << endl;
-                    continue;
-                }
+            auto req = std::move(it->second);
+            requests.erase(it);
+            curl_multi_remove_handle(worker.get_multi(), id);
 
-                auto req = std::move(it->second);
-                remove(req);
+            if (result == CURLE_OK)
+                req->parse();
 
-                if (msg->data.result != CURLE_OK) {
-                    req->on_exception(std::runtime_error{
-                        curl_easy_strerror(msg->data.result)
-                    });
-                }
-                else {
+            completions.push([req = std::move(req), result]
+            {
+                if (result != CURLE_OK)
+                    req->fail(std::runtime_error{curl_easy_strerror(result)});
+                else
                     req->finish();
-                }
+            });
+        }
+
+        // Runs on the UI thread.
+        void process()
+        {
+            for (;;) {
+                auto completion = completions.try_pop();
+                if (!completion)
+                    break;
+
+                (*completion)();
             }
         }
     };
@@ -292,10 +391,12 @@ namespace graphql {
 
     void token::cancel()
     {
-        if (req && req->current_status != status::finished) {
-            req->current_status = status::canceled;
+        if (!req)
+            return;
+
+        status expected = status::pending;
+        if (req->current_status.compare_exchange_strong(expected, status::canceled))
             res->remove(req);
-        }
     }
 
     void token::detach() noexcept
@@ -346,8 +447,7 @@ namespace graphql {
             url,
             query,
             variables,
-            std::move(data_func),
-            std::move(errors_func),
+            make_generic_parser(std::move(data_func), std::move(errors_func)),
             std::move(exception_func)
         );
 
@@ -379,6 +479,31 @@ namespace graphql {
         );
     }
 
+    token get_async_parsed(const std::string& url,
+                           const std::string& query,
+                           const std::string& variables_json,
+                           parse_function_t parse_func,
+                           exception_function_t exception_func)
+    {
+        glz::generic variables;
+
+        if (auto error = glz::read_json(variables, variables_json))
+            throw std::runtime_error{"glz::read_json() failed: "
+                                     + glz::format_error(error, variables_json)};
+
+        auto req = std::make_shared<request>(
+            url,
+            query,
+            variables,
+            std::move(parse_func),
+            std::move(exception_func)
+        );
+
+        res->add(req);
+
+        return token{std::move(req)};
+    }
+
     glz::generic get_sync(const std::string& url,
                           const std::string& query,
                           const glz::generic& variables)
@@ -399,13 +524,9 @@ namespace graphql {
 
         easy.post_data = *post_json;
 
-        byte_stream response;
-
         curl_easy_setopt(easy.handle, CURLOPT_POST, 1L);
         curl_easy_setopt(easy.handle, CURLOPT_POSTFIELDS, easy.post_data.c_str());
         curl_easy_setopt(easy.handle, CURLOPT_POSTFIELDSIZE, easy.post_data.size());
-        curl_easy_setopt(easy.handle, CURLOPT_WRITEFUNCTION, write_cb);
-        curl_easy_setopt(easy.handle, CURLOPT_WRITEDATA, &response);
 
         CURLcode code = curl_easy_perform(easy.handle);
         if (code != CURLE_OK)
@@ -419,7 +540,7 @@ namespace graphql {
             throw std::runtime_error{"Content-Type should be application/json, but got \""s
                                      + ct + "\""s};
 
-        auto response_str = response.read_str();
+        auto& response_str = easy.response;
 
         glz::generic result;
         auto error = glz::read_json(result, response_str);
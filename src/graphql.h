@@ -11,11 +11,14 @@
 
 #include <functional>
 #include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
 
 #include <curl/curl.h>
 
 #include <glaze/json/generic.hpp>
+#include <glaze/json/read.hpp>
 
 namespace graphql {
 
@@ -28,7 +31,6 @@ namespace graphql {
     using exception_function_sig = void (const std::exception& error);
     using exception_function_t = std::move_only_function<exception_function_sig>;
 
-
     struct request;
 
 
@@ -104,6 +106,74 @@ namespace graphql {
               exception_function_t exception_func = {});
 
 
+    template<typename T>
+    struct response {
+        std::optional<T> data;
+        std::optional<glz::generic> errors;
+    };
+
+    // Reads the response straight into T, without building a glz::generic for it.
+    template<typename T>
+    response<T>
+    decode(const std::string& json)
+    {
+        response<T> result;
+        if (auto error = glz::read<glz::opts{.error_on_unknown_keys = false}>(result, json))
+            throw std::runtime_error{"glz::read() failed: " + glz::format_error(error, json)};
+        return result;
+    }
+
+
+    // Runs on the UI thread; body is the response that was parsed.
+    using deliver_function_sig = void (const std::string& body);
+    using deliver_function_t = std::move_only_function<deliver_function_sig>;
+
+    // Runs on the worker thread, as soon as the transfer is done; what it returns is
+    // called from process().
+    using parse_function_sig = deliver_function_t (const std::string& body);
+    using parse_function_t = std::move_only_function<parse_function_sig>;
+
+    token
+    get_async_parsed(const std::string& url,
+                     const std::string& query,
+                     const std::string& variables_json,
+                     parse_function_t parse_func,
+                     exception_function_t exception_func = {});
+
+
+    template<typename T>
+    using response_function_sig = void (response<T>& response, const std::string& body);
+    template<typename T>
+    using response_function_t = std::move_only_function<response_function_sig<T>>;
+
+    // Like get_async(), but the response is decoded into T on the worker thread, and
+    // response_func only gets the result. Decoding errors go to exception_func.
+    template<typename T>
+    token
+    get_async_typed(const std::string& url,
+                    const std::string& query,
+                    const std::string& variables_json,
+                    response_function_t<T> response_func,
+                    exception_function_t exception_func = {})
+    {
+        auto parse = [response_func = std::move(response_func)](const std::string& json) mutable
+            -> deliver_function_t
+        {
+            return [response_func = std::move(response_func),
+                    result = decode<T>(json)](const std::string& body) mutable
+            {
+                response_func(result, body);
+            };
+        };
+
+        return get_async_parsed(url,
+                                query,
+                                variables_json,
+                                std::move(parse),
+                                std::move(exception_func));
+    }
+
+
     glz::generic
     get_sync(const std::string& url,
              const std::string& query,
@@ -30,6 +30,7 @@
 #include <coreinit/systeminfo.h>
 
 #include "installer.h"
+#include "pixel_sidecar.hpp"
 #include "utils.h"
 
 using std::cout;
@@ -470,6 +471,7 @@ namespace Installer {
             thumbnailPath = THEMIIFY_THUMBNAILS / installPath.stem();
             thumbnailPath.replace_extension(".webp");
             DeletePath(thumbnailPath);
+            DeletePath(pixel_sidecar::path_for(thumbnailPath));
         }
 
         if (exists(modpackPath) && exists(installPath) && exists(thumbnailPath)) {
@@ -0,0 +1,218 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+
+#include "pixel_sidecar.hpp"
+
+
+using std::cerr;
+using std::endl;
+
+
+namespace {
+
+    const std::uint32_t sidecar_magic = 0x544d5058; // "TMPX"
+    const std::uint32_t sidecar_version = 1;
+
+    // Thumbnails are about 400 KiB of pixels; anything much larger isn't one.
+    const std::uint32_t max_pixel_bytes = 16 * 1024 * 1024;
+
+
+    struct sidecar_header {
+        std::uint32_t magic;
+        std::uint32_t version;
+        // Of the image file.
+        std::uint64_t source_size;
+        std::int64_t source_time;
+        std::uint32_t format;
+        std::int32_t width;
+        std::int32_t height;
+        std::int32_t pitch;
+        std::int32_t max_width;
+        std::int32_t max_height;
+        // Deflated size of the pixels.
+        std::uint32_t data_size;
+        std::uint32_t reserved;
+    };
+
+
+    // Fills in the fields that identify the image file; false if it can't be read.
+    bool
+    describe_source(const std::filesystem::path& image,
+                    sidecar_header& header)
+    {
+        std::error_code ec;
+
+        auto size = std::filesystem::file_size(image, ec);
+        if (ec)
+            return false;
+
+        auto time = std::filesystem::last_write_time(image, ec);
+        if (ec)
+            return false;
+
+        header.source_size = size;
+        header.source_time = time.time_since_epoch().count();
+        return true;
+    }
+
+
+    void
+    replace_file(const std::filesystem::path& src,
+                 const std::filesystem::path& dst)
+    {
+        // NOTE: rename() on the SD card won't replace an existing file.
+        std::error_code ec;
+        std::filesystem::remove(dst, ec);
+        std::filesystem::rename(src, dst);
+    }
+
+} // namespace
+
+
+namespace pixel_sidecar {
+
+    std::filesystem::path
+    path_for(const std::filesystem::path& image)
+    {
+        auto result = image;
+        result += ".px";
+        return result;
+    }
+
+
+    SDL_Surface*
+    load(const std::filesystem::path& image,
+         Uint32 format,
+         int max_width,
+         int max_height)
+    {
+        std::ifstream in{path_for(image), std::ios::binary};
+        if (!in)
+            return nullptr;
+
+        sidecar_header expected{};
+        if (!describe_source(image, expected))
+            return nullptr;
+
+        sidecar_header header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof header))
+            return nullptr;
+
+        if (header.magic != sidecar_magic
+            || header.version != sidecar_version
+            || header.source_size != expected.source_size
+            || header.source_time != expected.source_time
+            || header.format != format
+            || header.max_width != max_width
+            || header.max_height != max_height)
+            return nullptr;
+
+        const std::uint64_t pixel_bytes = std::uint64_t(header.pitch) * header.height;
+        if (header.width <= 0 || header.height <= 0
+            || header.pitch < header.width * SDL_BYTESPERPIXEL(format)
+            || pixel_bytes > max_pixel_bytes
+            || header.data_size > compressBound(pixel_bytes))
+            return nullptr;
+
+        std::vector<char> data(header.data_size);
+        if (!in.read(data.data(), data.size()))
+            return nullptr;
+
+        SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0,
+                                                              header.width,
+                                                              header.height,
+                                                              SDL_BITSPERPIXEL(format),
+                                                              format);
+        if (!surface)
+            return nullptr;
+
+        // Surfaces of the same size and format get the same pitch.
+        uLongf size = pixel_bytes;
+        if (surface->pitch != header.pitch
+            || uncompress(static_cast<Bytef*>(surface->pixels),
+                          &size,
+                          reinterpret_cast<const Bytef*>(data.data()),
+                          data.size()) != Z_OK
+            || size != pixel_bytes) {
+            cerr << "WARNING: pixel_sidecar: ignoring bad sidecar for " << image << endl;
+            SDL_FreeSurface(surface);
+            return nullptr;
+        }
+
+        return surface;
+    }
+
+
+    void
+    save(const std::filesystem::path& image,
+         SDL_Surface* surface,
+         int max_width,
+         int max_height)
+    {
+        try {
+            sidecar_header header{};
+            if (!describe_source(image, header))
+                return;
+
+            header.magic = sidecar_magic;
+            header.version = sidecar_version;
+            header.format = surface->format->format;
+            header.width = surface->w;
+            header.height = surface->h;
+            header.pitch = surface->pitch;
+            header.max_width = max_width;
+            header.max_height = max_height;
+
+            const uLong pixel_bytes = static_cast<uLong>(surface->pitch) * surface->h;
+            if (pixel_bytes > max_pixel_bytes)
+                return;
+
+            std::vector<char> data(compressBound(pixel_bytes));
+            uLongf size = data.size();
+            if (compress2(reinterpret_cast<Bytef*>(data.data()),
+                          &size,
+                          static_cast<const Bytef*>(surface->pixels),
+                          pixel_bytes,
+                          Z_BEST_SPEED) != Z_OK)
+                throw std::runtime_error{"compress2() failed"};
+            header.data_size = size;
+
+            // Two decoders may be writing the same sidecar.
+            auto target = path_for(image);
+            auto temp = target;
+            temp += ".tmp" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+            {
+                std::ofstream out{temp, std::ios::binary | std::ios::trunc};
+                out.write(reinterpret_cast<const char*>(&header), sizeof header);
+                out.write(data.data(), size);
+                if (!out.flush())
+                    throw std::runtime_error{"could not write " + temp.string()};
+            }
+
+            replace_file(temp, target);
+        }
+        catch (std::exception& e) {
+            cerr << "WARNING: pixel_sidecar::save(): " << image << ": " << e.what() << endl;
+        }
+    }
+
+} // namespace pixel_sidecar
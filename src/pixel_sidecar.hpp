@@ -0,0 +1,49 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef PIXEL_SIDECAR_HPP
+#define PIXEL_SIDECAR_HPP
+
+#include <filesystem>
+
+#include <SDL2/SDL.h>
+
+
+// Decoded pixels of an image file, stored next to it, so it doesn't have to be decoded
+// again on the next launch. The pixels are in the renderer's format, deflated with
+// zlib at its fastest level.
+//
+// A sidecar is only used while the image file keeps the same size and modification
+// time, and for the same pixel format and downscaling target.
+namespace pixel_sidecar {
+
+    [[nodiscard]]
+    std::filesystem::path
+    path_for(const std::filesystem::path& image);
+
+
+    // Returns null if there's no usable sidecar.
+    [[nodiscard]]
+    SDL_Surface*
+    load(const std::filesystem::path& image,
+         Uint32 format,
+         int max_width,
+         int max_height);
+
+
+    // Failures are only logged; the image can always be decoded again.
+    void
+    save(const std::filesystem::path& image,
+         SDL_Surface* surface,
+         int max_width,
+         int max_height);
+
+} // namespace pixel_sidecar
+
+#endif
@@ -15,11 +15,9 @@
 #include <imgui_raii.h>
 
 #include "DownloadThemePopup.h"
-#include "InstallThemePopup.h"
+#include "DownloadsPopup.h"
 #include "../utils.h"
 #include "../DownloadManager.h"
-#include "../humanize.hpp"
-#include "../installer.h"
 
 using std::cout;
 using std::endl;
@@ -29,26 +27,23 @@ namespace DownloadThemePopup {
     enum class State {
         hidden,
         confirmation,
-        downloading,
-        error,
-        success,
+        queued,
     };
 
     State state;
 
     bool popup_queued;
     const std::string popup_id = "Download Theme";
-    std::filesystem::path utheme_path;
 
     ThemezerAPI::WiiuThemeSmall theme;
 
-    bool set_current = true;
+    // Whether the last DownloadManager::add() call accepted the theme.
+    bool added = false;
 
     void show(const ThemezerAPI::WiiuThemeSmall &theme_data) {
         state = State::confirmation;
         popup_queued = true;
         theme = theme_data;
-        utheme_path = "";
     }
 
     void process_ui() {
@@ -107,16 +102,15 @@ namespace DownloadThemePopup {
                     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + start_x);
 
                 if (ImGui::Button("Download", button_size)) {
-                    if (DownloadManager::add("Theme: " + theme.name,
-                                             theme.downloadUrl,
-                                             theme.collagePreview.thumbUrl,
-                                             THEMES_ROOT / (theme.slug + ".utheme"),
-                                             THEMIIFY_THUMBNAILS / ("Themezer" + theme.hexId + ".webp"),
-                                             {},
-                                             {})) {
-                    }
-
-                    state = State::downloading;
+                    added = DownloadManager::add("Theme: " + theme.name,
+                                                 theme.downloadUrl,
+                                                 theme.collagePreview.thumbUrl,
+                                                 THEMES_ROOT / (theme.slug + ".utheme"),
+                                                 THEMIIFY_THUMBNAILS / ("Themezer" + theme.hexId + ".webp"),
+                                                 {},
+                                                 {});
+
+                    state = State::queued;
                 }
                 ImGui::SetItemDefaultFocus();
 
@@ -131,52 +125,20 @@ namespace DownloadThemePopup {
 
                 break;
             }
-            case State::downloading: {
-                auto& infos = DownloadManager::get_infos();
-                // Don't really wanna do a multiple downloads approach
-                // I think this is cleaner for actually installing themes
-                // Afterwards
-                auto& info = infos.at(0);
-
-                utheme_path = info->utheme_output;
-
+            case State::queued: {
                 {
                     Font title_font{nullptr, 35};
                     ImGui::AlignTextToFramePadding();
-                    ImGui::Text("Downloading Theme...");
+                    ImGui::Text(added ? "Download Started" : "Already Downloading");
                 }
 
-                ImGui::Text(info->label);
-
-                ImGui::Text(info->utheme_url);
+                if (added)
+                    ImGui::TextWrapped("%s was added to the downloads.", theme.name.c_str());
+                else
+                    ImGui::TextWrapped("%s is already in the downloads.", theme.name.c_str());
 
-                ImGui::TextWrapped("Saving to: %s", info->utheme_output.filename().c_str());
-
-                //auto speed = humanize::value_bin(info->speed) + "B/s";
-                //ImGui::Text("DL speed: %s", speed.data());
-
-                ImGui::ProgressBar(info->progress);
-
-                if (info->progress >= 1.0f) {
-                    DownloadManager::clear_finished();
-                    state = State::success;
-                }
-
-                break;
-            }
-            case State::error: {
-                break;
-            }
-            case State::success: {
-                {
-                    Font title_font{nullptr, 50};
-                    ImGui::AlignTextToFramePadding();
-                    ImGui::Text("Download successful!");
-                }
-
-                ImGui::TextWrapped("Would you like to install this theme for StyleMiiU plugin?");
-
-                ImGui::Checkbox("Set as current theme", &set_current);
+                ImGui::TextWrapped("You can keep browsing while it downloads, and install it "
+                                   "from the Downloads window once it's done.");
 
                 ImGui::Spacing();
 
@@ -190,22 +152,19 @@ namespace DownloadThemePopup {
                 if (start_x > 0.0f)
                     ImGui::SetCursorPosX(ImGui::GetCursorPosX() + start_x);
 
-                if (ImGui::Button("Install", button_size)) {
-                    Installer::theme_data theme_data;
-                    Installer::GetThemeMetadata(utheme_path, &theme_data);
-
+                if (ImGui::Button("OK", button_size)) {
                     ImGui::CloseCurrentPopup();
                     state = State::hidden;
-
-                    InstallThemePopup::show(utheme_path, theme_data, true, set_current);
                 }
                 ImGui::SetItemDefaultFocus();
 
                 ImGui::SameLine();
 
-                if (ImGui::Button("Cancel", button_size)) {
+                if (ImGui::Button("Downloads", button_size)) {
                     ImGui::CloseCurrentPopup();
                     state = State::hidden;
+
+                    DownloadsPopup::show();
                 }
 
                 ImGui::Spacing();
@@ -0,0 +1,207 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <filesystem>
+#include <string>
+
+#include <imgui.h>
+#include <imgui_raii.h>
+
+#include "DownloadsPopup.h"
+#include "InstallThemePopup.h"
+#include "../DownloadManager.h"
+#include "../IconsFontAwesome4.h"
+#include "../humanize.hpp"
+#include "../installer.h"
+
+using namespace std::literals;
+
+namespace DownloadsPopup {
+    enum class State {
+        hidden,
+        shown,
+    };
+
+    State state;
+
+    bool popup_queued;
+    const std::string popup_id = "Downloads";
+
+    bool set_current = true;
+
+    void show() {
+        state = State::shown;
+        popup_queued = true;
+    }
+
+    const char* state_to_label(DownloadManager::State st) {
+        using DownloadManager::State;
+        switch (st) {
+            case State::queued:      return "Queued";
+            case State::in_progress: return "Downloading";
+            case State::finished:    return "Finished";
+            case State::paused:      return "Paused";
+            case State::canceled:    return "Canceled";
+            case State::failed:      return "Failed";
+            default:                 return "?";
+        }
+    }
+
+    // Returns true if the popup should close.
+    bool show_download(const DownloadManager::Info& info) {
+        using DownloadManager::State;
+
+        // NOTE: take one snapshot, so the whole row is consistent.
+        const auto status = info.status.load();
+
+        ImGui::PushID(info.utheme_url.c_str());
+
+        ImGui::TextWrapped("%s", info.label.c_str());
+        ImGui::TextDisabled("%s", info.utheme_output.filename().c_str());
+
+        if (status.state == State::in_progress) {
+            auto speed = humanize::value_bin(status.speed) + "B/s";
+            ImGui::Text("%s - %s", state_to_label(status.state), speed.c_str());
+        }
+        else {
+            ImGui::Text("%s", state_to_label(status.state));
+        }
+
+        if (DownloadManager::is_active(status.state))
+            ImGui::ProgressBar(status.progress);
+
+        if (!info.error.empty())
+            ImGui::TextWrapped("%s", info.error.c_str());
+
+        bool close = false;
+
+        switch (status.state) {
+            case State::queued:
+            case State::in_progress:
+                if (ImGui::Button(ICON_FA_PAUSE " Pause"))
+                    DownloadManager::pause(info.utheme_url);
+                ImGui::SameLine();
+                if (ImGui::Button(ICON_FA_TIMES " Cancel"))
+                    DownloadManager::cancel(info.utheme_url);
+                break;
+
+            case State::paused:
+                if (ImGui::Button(ICON_FA_PLAY " Resume"))
+                    DownloadManager::resume(info.utheme_url);
+                ImGui::SameLine();
+                if (ImGui::Button(ICON_FA_TIMES " Cancel"))
+                    DownloadManager::cancel(info.utheme_url);
+                break;
+
+            case State::finished:
+                // UpdateChecker installs these itself.
+                if (info.is_update)
+                    break;
+                if (ImGui::Button(ICON_FA_CHECK " Install")) {
+                    Installer::theme_data theme_data;
+                    Installer::GetThemeMetadata(info.utheme_output, &theme_data);
+
+                    InstallThemePopup::show(info.utheme_output, theme_data, true, set_current);
+                    close = true;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        ImGui::Separator();
+
+        ImGui::PopID();
+
+        return close;
+    }
+
+    void process_ui() {
+        using namespace ImGui::RAII;
+        if (state == State::hidden)
+            return;
+
+        if (popup_queued) {
+            ImGui::OpenPopup(popup_id);
+            popup_queued = false;
+        }
+
+        auto viewport = ImGui::GetMainViewport();
+        ImGui::SetNextWindowSize(viewport->Size * 0.75f, ImGuiCond_Always);
+        auto center = viewport->GetCenter();
+        ImGui::SetNextWindowPos(center, ImGuiCond_Always, {0.5f, 0.5f});
+        PopupModal popup{popup_id, nullptr,
+                         ImGuiWindowFlags_NoSavedSettings |
+                         ImGuiWindowFlags_NoMove |
+                         ImGuiWindowFlags_NoCollapse |
+                         ImGuiWindowFlags_NoTitleBar |
+                         ImGuiWindowFlags_None
+        };
+
+        if (!popup) {
+            state = State::hidden;
+            return;
+        }
+
+        {
+            Font title_font{nullptr, 35};
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("Downloads");
+        }
+
+        if (ImGui::Button(ICON_FA_PAUSE " Pause All"))
+            DownloadManager::pause_all();
+
+        ImGui::SameLine();
+
+        if (ImGui::Button(ICON_FA_PLAY " Resume All"))
+            DownloadManager::resume_all();
+
+        ImGui::SameLine();
+
+        if (ImGui::Button(ICON_FA_TIMES " Cancel All"))
+            DownloadManager::cancel_all();
+
+        ImGui::SameLine();
+
+        if (ImGui::Button(ICON_FA_TRASH " Clear Finished"))
+            DownloadManager::clear_finished();
+
+        ImGui::Checkbox("Set as current theme when installing", &set_current);
+
+        bool close = false;
+
+        const float footer_height = ImGui::GetFrameHeightWithSpacing() + 60.0f;
+        if (Child download_list{"DownloadList", {0, -footer_height}, ImGuiChildFlags_NavFlattened}) {
+            auto& infos = DownloadManager::get_infos();
+
+            if (infos.empty())
+                ImGui::TextDisabled("Nothing is being downloaded.");
+
+            for (auto& info : infos)
+                close = show_download(*info) || close;
+        }
+
+        ImGui::Spacing();
+
+        ImVec2 button_size{180.0f, 60.0f};
+
+        float start_x = (ImGui::GetContentRegionAvail().x - button_size.x) * 0.5f;
+
+        if (start_x > 0.0f)
+            ImGui::SetCursorPosX(ImGui::GetCursorPosX() + start_x);
+
+        if (ImGui::Button("Close", button_size) || close) {
+            ImGui::CloseCurrentPopup();
+            state = State::hidden;
+        }
+        ImGui::SetItemDefaultFocus();
+    }
+}
@@ -12,11 +12,11 @@
 #include "SettingsPopup.h"
 #include "../NavBar.h"
 #include "../installer.h"
+#include "../ImageLoader.h"
 #include "../IconsFontAwesome4.h"
 #include "../utils.h"
 
 #include <iostream>
-#include <unordered_map>
 #include <filesystem>
 
 #include <SDL2/SDL.h>
@@ -35,8 +35,6 @@ using std::endl;
 // #define DEBUG_BG_COLOR
 
 namespace HomeScreen {
-    SDL_Renderer *home_renderer = nullptr;
-
     SDL_Texture *themiify_logo = nullptr;
 
     std::string current_theme_str;
@@ -45,7 +43,6 @@ namespace HomeScreen {
     std::string current_theme_thumbnail_path;
 
     Installer::installed_theme_data current_theme_data;
-    SDL_Texture *current_theme_thumbnail = nullptr;
 
     bool current_theme_refresh = true;
 
@@ -53,25 +50,6 @@ namespace HomeScreen {
     bool styleMiiUExists = true;
     bool queueStyleMiiUPrompt = false;
 
-    std::unordered_map<std::string, SDL_Texture*> thumbnail_cache;
-    SDL_Texture* placeholder_thumbnail = nullptr;
-
-    SDL_Texture *getThumbnail(const std::filesystem::path& path) {
-        std::string key = path.string();
-
-        auto it = thumbnail_cache.find(key);
-        if (it != thumbnail_cache.end())
-            return it->second;
-
-        SDL_Texture* tex = IMG_LoadTexture(home_renderer, key.c_str());
-
-        if (!tex)
-            return placeholder_thumbnail;
-
-        thumbnail_cache[key] = tex;
-        return tex;
-    }
-
     std::string get_theme_id(const std::string& str) {
         auto open = str.rfind('(');
         auto close = str.rfind(')');
@@ -99,9 +77,7 @@ namespace HomeScreen {
             &current_theme_data
         );
 
-        if (res == 1)
-            current_theme_thumbnail = getThumbnail(current_theme_thumbnail_path);
-        else
+        if (res != 1)
             current_theme_data.themeIDPath = "";
 
         current_theme_refresh = false;
@@ -130,10 +106,7 @@ namespace HomeScreen {
     void initialize(SDL_Renderer *renderer) {
         cout << "Hello from HomeScreen init!" << endl;
 
-        home_renderer = renderer;
-
         themiify_logo = IMG_LoadTexture(renderer, "fs:/vol/content/ui/themiify-logo.png");
-        placeholder_thumbnail = IMG_LoadTexture(renderer, "fs:/vol/content/ui/theme-placeholder-icon.png");
 
         current_theme_refresh = true;
 
@@ -149,18 +122,6 @@ namespace HomeScreen {
     void finalize() {
         cout << "Hello from HomeScreen finalize!" << endl;
 
-        for (auto& [path, tex] : thumbnail_cache) {
-            if (tex)
-                SDL_DestroyTexture(tex);
-        }
-
-        thumbnail_cache.clear();
-
-        if (placeholder_thumbnail) {
-            SDL_DestroyTexture(placeholder_thumbnail);
-            placeholder_thumbnail = nullptr;
-        }
-
         if (themiify_logo) {
             SDL_DestroyTexture(themiify_logo);
             themiify_logo = nullptr;
@@ -247,7 +208,8 @@ namespace HomeScreen {
                     ImGuiWindowFlags_NoSavedSettings
                 };
 
-                ImGui::Image((ImTextureID)current_theme_thumbnail, {426, 240});
+                auto thumbnail = ImageLoader::get_image(current_theme_thumbnail_path, 426, 240);
+                ImGui::Image((ImTextureID)thumbnail.texture, {426, 240}, thumbnail.uv0, thumbnail.uv1);
 
                 ImGui::SameLine();
 
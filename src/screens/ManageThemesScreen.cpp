@@ -8,12 +8,10 @@
  */
 
 #include <iostream>
-#include <unordered_map>
 #include <cctype>
 #include <algorithm>
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_image.h>
 
 #include <imgui.h>
 #include <imgui_raii.h>
@@ -23,6 +21,8 @@
 #include "ThemeDetailsPopup.h"
 #include "DeleteThemePopup.h"
 #include "../installer.h"
+#include "../ImageLoader.h"
+#include "../UpdateChecker.h"
 #include "../utils.h"
 #include "../IconsFontAwesome4.h"
 
@@ -49,31 +49,9 @@ namespace ManageThemesScreen {
     bool local_themes_refresh = true;
     bool is_current_theme = false;
 
-    SDL_Renderer *manage_renderer;
-
-    SDL_Texture *thumbnail;
-    std::unordered_map<std::string, SDL_Texture*> thumbnail_cache;
-    SDL_Texture* placeholder_thumbnail = nullptr;
-
     std::string search;
     std::string current_theme;
 
-    SDL_Texture *getThumbnail(const std::filesystem::path& path) {
-        std::string key = path.string();
-
-        auto it = thumbnail_cache.find(key);
-        if (it != thumbnail_cache.end())
-            return it->second;
-
-        SDL_Texture* tex = IMG_LoadTexture(manage_renderer, key.c_str());
-
-        if (!tex)
-            return placeholder_thumbnail;
-
-        thumbnail_cache[key] = tex;
-        return tex;
-    }
-
     std::string as_lower_case(std::string s) {
         for (char &c : s)
             c = std::tolower(static_cast<unsigned char>(c));
@@ -142,30 +120,14 @@ namespace ManageThemesScreen {
         }
     }
 
-    void initialize(SDL_Renderer *renderer) {
+    void initialize(SDL_Renderer *) {
         cout << "Hello from InstalledScreen init!" << endl;
         create_directories(THEMES_ROOT);
         create_directories(THEMIIFY_INSTALLED_THEMES);
-
-        manage_renderer = renderer;
-
-        placeholder_thumbnail = IMG_LoadTexture(manage_renderer, "fs:/vol/content/ui/theme-placeholder-icon.png");
     }
 
     void finalize() {
         cout << "Hello from InstalledScreen finalize!" << endl;
-
-        for (auto& [path, tex] : thumbnail_cache) {
-            if (tex)
-                SDL_DestroyTexture(tex);
-        }
-
-        thumbnail_cache.clear();
-
-        if (placeholder_thumbnail) {
-            SDL_DestroyTexture(placeholder_thumbnail);
-            placeholder_thumbnail = nullptr;
-        }
     }
 
     void force_refresh() {
@@ -267,9 +229,23 @@ namespace ManageThemesScreen {
                             std::rotate(json_files.begin(), json_files.begin() + index, json_files.begin() + index + 1);
                         }
 
+                        UpdateChecker::check(installed_themes);
+
                         local_themes_refresh = false;
                     }
 
+                    if (UpdateChecker::is_checking()) {
+                        ImGui::AlignTextToFramePadding();
+                        ImGui::Text(ICON_FA_SPINNER " Checking for updates...");
+                    }
+                    else if (std::size_t outdated = UpdateChecker::num_outdated()) {
+                        ImGui::AlignTextToFramePadding();
+                        ImGui::Text("%zu themes have updates on Themezer.", outdated);
+                        ImGui::SameLine();
+                        if (ImGui::Button(ICON_FA_REFRESH " Update All"))
+                            UpdateChecker::update_all();
+                    }
+
                     std::vector<std::size_t> visible_indexes;
 
                     for (std::size_t i = 0; i < installed_themes.size(); ++i) {
@@ -367,9 +343,9 @@ namespace ManageThemesScreen {
                             auto thumbnailPath =
                                 THEMIIFY_THUMBNAILS / (theme_data.themeIDPath + ".webp");
 
-                            SDL_Texture* thumbnail = getThumbnail(thumbnailPath);
+                            auto thumbnail = ImageLoader::get_image(thumbnailPath.string(), 426, 240);
 
-                            ImGui::Image((ImTextureID)thumbnail, {426, 240});
+                            ImGui::Image((ImTextureID)thumbnail.texture, {426, 240}, thumbnail.uv0, thumbnail.uv1);
 
                             ImGui::SameLine();
 
@@ -379,8 +355,23 @@ namespace ManageThemesScreen {
                                 ImGui::TextWrapped("%s", theme_data.themeName.c_str());
                                 ImGui::TextWrapped("by: %s", theme_data.themeAuthor.c_str());
 
+                                switch (UpdateChecker::get_status(theme_data.themeIDPath)) {
+                                    case UpdateChecker::Status::outdated:
+                                        if (ImGui::Button(ICON_FA_REFRESH " Update"))
+                                            UpdateChecker::update(theme_data.themeIDPath);
+                                        ImGui::SameLine();
+                                        break;
+                                    case UpdateChecker::Status::updating:
+                                        ImGui::AlignTextToFramePadding();
+                                        ImGui::Text(ICON_FA_SPINNER " Updating...");
+                                        ImGui::SameLine();
+                                        break;
+                                    default:
+                                        break;
+                                }
+
                                 if (ImGui::Button(ICON_FA_INFO_CIRCLE " Details")) {
-                                    ThemeDetailsPopup::show_local(theme_data, thumbnail, is_current_theme);
+                                    ThemeDetailsPopup::show_local(theme_data, thumbnailPath.string(), is_current_theme);
                                 }
 
                                 ImGui::SameLine();
@@ -9,6 +9,8 @@
 
 #include "SettingsPopup.h"
 #include "../utils.h"
+#include "../ImageLoader.h"
+#include "../ThemezerAPI.h"
 
 #include <coreinit/systeminfo.h>
 #include <sysapp/title.h>
@@ -668,8 +670,11 @@ namespace SettingsPopup {
 
                 if (ImGui::Button("Clear Cache", button_size)) {
                     start_worker([] {
-                        if (delete_thumbnails)
+                        if (delete_thumbnails) {
                             DeletePath(THEMIIFY_THUMBNAILS);
+                            ImageLoader::clear_disk_cache();
+                            ThemezerAPI::clear_disk_cache();
+                        }
 
                         DeletePath(THEMIIFY_ROOT / "cache/Common");
 
@@ -52,7 +52,7 @@ namespace ThemeDetailsPopup {
     WiiuThemeFull theme;
     WiiuThemeSmall smallTheme;
     Installer::installed_theme_data installedThemeData;
-    SDL_Texture *localPreview;
+    std::string localPreview;
     const std::string popup_id = "ThemeDetailsPopup"s;
     bool isCurrent;
 
@@ -63,17 +63,22 @@ namespace ThemeDetailsPopup {
         error.clear();
         theme = {};
         smallTheme = small_theme;
+        // A cached theme comes back before this returns.
+        state = State::waiting;
         ThemezerAPI::wiiu::theme(hexId,
-                                 [](const WiiuThemeFull& t)
+                                 [request_id](const WiiuThemeFull& t)
                                  {
+                                    // An update for a theme that's not shown anymore.
+                                    if (request_id != hexId || state == State::hidden)
+                                        return;
                                     cout << "Got theme!" << endl;
                                     theme = t;
                                     state = State::ready_themezer;
-                                 });
-        state = State::waiting;
+                                 },
+                                 ThemezerAPI::Category::details);
     }
 
-    void show_local(Installer::installed_theme_data installed_theme_data, SDL_Texture *local_preview, bool is_current) {
+    void show_local(Installer::installed_theme_data installed_theme_data, const std::string& local_preview, bool is_current) {
         popup_queued = true;
         installedThemeData = installed_theme_data;
         localPreview = local_preview;
@@ -136,7 +141,7 @@ namespace ThemeDetailsPopup {
 
                     if (theme.creator.avatarUrl) {
                         ImGui::SameLine();
-                        auto avatar = ImageLoader::get(*theme.creator.avatarUrl);
+                        auto avatar = ImageLoader::get(*theme.creator.avatarUrl, 64, 64);
                         ImGui::Image((ImTextureID)avatar, {64, 64});
                         ImGui::SetItemTooltip(*theme.creator.avatarUrl);
                     }
@@ -147,8 +152,10 @@ namespace ThemeDetailsPopup {
                         ImGui::Text(ICON_FA_TAG " %s", tag.name.data());
                     ImGui::Unindent();
 
-                    auto collageImg = ImageLoader::get(theme.collagePreview.sdUrl);
                     float collageWidth = 720;
+                    auto collageImg = ImageLoader::get(ThemePreviewPopup::variants(theme.collagePreview),
+                                                       collageWidth,
+                                                       405);
                     ImGui::SetCursorPosX(
                         ImGui::GetCursorPosX() +
                         (ImGui::GetContentRegionAvail().x - collageWidth) * 0.5f
@@ -161,9 +168,9 @@ namespace ThemeDetailsPopup {
                                                {collageWidth, 405})) {
                             ThemePreviewPopup::show(theme.hexId,
                                                     {
-                                                        theme.launcherScreenshot.hdUrl,
-                                                        theme.waraWaraPlazaScreenshot.hdUrl,
-                                                        theme.collagePreview.hdUrl
+                                                        theme.launcherScreenshot,
+                                                        theme.waraWaraPlazaScreenshot,
+                                                        theme.collagePreview
                                                     }
                             );
                         }
@@ -189,9 +196,9 @@ namespace ThemeDetailsPopup {
                     if (ImGui::Button(text)) {
                         ThemePreviewPopup::show(theme.hexId,
                                                 {
-                                                    theme.launcherScreenshot.hdUrl,
-                                                    theme.waraWaraPlazaScreenshot.hdUrl,
-                                                    theme.collagePreview.hdUrl
+                                                    theme.launcherScreenshot,
+                                                    theme.waraWaraPlazaScreenshot,
+                                                    theme.collagePreview
                                                 }
                         );
                     }
@@ -223,7 +230,7 @@ namespace ThemeDetailsPopup {
                     {
                         StyleVar no_padding{ImGuiStyleVar_FramePadding, {0.0f, 0.0f}};
                         ImGui::ImageButton("collagePreviewSD",
-                                           (ImTextureID)localPreview,
+                                           (ImTextureID)ImageLoader::get(localPreview),
                                            {collageWidth, 405});
                     }
                 }
@@ -16,7 +16,7 @@
 
 namespace ThemeDetailsPopup {
     void show_themezer(const std::string& request_id, const ThemezerAPI::WiiuThemeSmall &small_theme);
-    void show_local(Installer::installed_theme_data installed_theme_data, SDL_Texture *local_preview, bool is_current);
+    void show_local(Installer::installed_theme_data installed_theme_data, const std::string& local_preview, bool is_current);
 
     void process_ui();
 }
\ No newline at end of file
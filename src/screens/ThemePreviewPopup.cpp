@@ -18,7 +18,6 @@
 #include <cafe_glyphs.h>
 
 #include "ThemePreviewPopup.h"
-#include "../ImageLoader.h"
 #include "../IconsFontAwesome4.h"
 
 using std::cout;
@@ -40,7 +39,7 @@ namespace ThemePreviewPopup {
         const std::string popup_id = "ThemePreviewPopup"s;
 
         std::string hex_id;
-        std::vector<std::string> url_list;
+        std::vector<std::vector<ImageLoader::Variant>> image_list;
 
         bool hide_ui;
 
@@ -58,12 +57,26 @@ namespace ThemePreviewPopup {
 
     } // namespace
 
-    void show(const std::string& hexId, const std::vector<std::string>& urlList) {
+    void show(const std::string& hexId, const std::vector<ThemezerAPI::ImageSizesHd>& images) {
         state = State::visible;
         popup_queued = true;
         hide_ui = false;
         hex_id = hexId;
-        url_list = urlList;
+
+        image_list.clear();
+        for (auto& image : images)
+            image_list.push_back(variants(image));
+    }
+
+    std::vector<ImageLoader::Variant> variants(const ThemezerAPI::ImageSizesHd& sizes) {
+        std::vector<ImageLoader::Variant> result{
+            {sizes.tinyUrl,  320,  180},
+            {sizes.thumbUrl, 426,  240},
+            {sizes.sdUrl,    640,  360},
+            {sizes.hdUrl,    1280, 720},
+        };
+        std::erase_if(result, [](const auto& v) { return v.location.empty(); });
+        return result;
     }
 
     void process_ui() {
@@ -107,10 +120,10 @@ namespace ThemePreviewPopup {
         StyleVar carousel_no_rounding {ImGuiStyleVar_ChildRounding, 0};
         if (Carousel images_carousel{"images_carousel", page_size, specs}) {
 
-            for (auto [idx, url] : url_list | std::views::enumerate) {
+            for (auto [idx, image] : image_list | std::views::enumerate) {
                 if (idx > 0)
                     ImGui::SameLine();
-                auto tex = ImageLoader::get(url);
+                auto tex = ImageLoader::get(image, page_size.x, page_size.y);
                 ImGui::SetNextItemAllowOverlap();
                 ImGui::Image((ImTextureID)tex, page_size);
             }
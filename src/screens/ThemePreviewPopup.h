@@ -12,8 +12,14 @@
 #include <string>
 #include <vector>
 
+#include "../ImageLoader.h"
+#include "../ThemezerAPI.h"
+
 namespace ThemePreviewPopup {
-    void show(const std::string& hexId, const std::vector<std::string>& urlList);
+    void show(const std::string& hexId, const std::vector<ThemezerAPI::ImageSizesHd>& images);
+
+    // The resolutions Themezer provides for an image, for ImageLoader::get().
+    std::vector<ImageLoader::Variant> variants(const ThemezerAPI::ImageSizesHd& sizes);
 
     void process_ui();
 }
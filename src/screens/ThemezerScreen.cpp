@@ -8,6 +8,7 @@
  */
 
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <optional>
 #include <stdexcept>
@@ -24,11 +25,13 @@
 #include "ThemezerScreen.h"
 #include "ThemeDetailsPopup.h"
 #include "DownloadThemePopup.h"
+#include "DownloadsPopup.h"
 #include "InstallThemePopup.h"
 #include "QRCodePopup.h"
 #include "../utils.h"
 #include "../ImageLoader.h"
 #include "../ThemezerAPI.h"
+#include "../ThemezerCatalog.h"
 #include "../DownloadManager.h"
 #include "../IconsFontAwesome4.h"
 
@@ -61,8 +64,30 @@ namespace ThemezerScreen {
 
     std::optional<PageInfo> page_info;
     std::optional<WiiuThemeSmallVec> themes;
+    // One per theme, so drawing the cards doesn't look up the thumbnails every frame.
+    std::vector<ImageLoader::Handle> thumbnails;
     std::optional<WiiuThemeSmall> exact_theme;
 
+    // The next page is fetched while the user looks at the current one, and its
+    // thumbnails are prefetched, so turning the page shows them right away.
+    using PageKey = std::tuple<unsigned, ItemSort, SortOrder, std::string>;
+    std::optional<PageKey> next_key;
+    // What themes holds; a cached page can be updated after it's shown.
+    std::optional<PageKey> shown_key;
+    std::optional<WiiuThemeSmallVec> next_themes;
+    std::optional<PageInfo> next_page_info;
+
+    // Only pending while a request is in flight.
+    graphql::token page_token;
+    graphql::token prefetch_token;
+    graphql::token lookup_token;
+    // The ID being looked up.
+    std::string lookup_id;
+
+    // Typing only starts a search once it stops for a moment.
+    const std::chrono::milliseconds search_delay{500};
+    std::optional<std::chrono::steady_clock::time_point> search_at;
+
     SDL_Texture* themezer_logo = nullptr;
 
     Mix_Chunk *qr_sfx;
@@ -96,6 +121,8 @@ namespace ThemezerScreen {
         small.collagePreview.thumbUrl = full.collagePreview.thumbUrl;
         small.downloadCount = full.downloadCount;
         small.downloadUrl = full.downloadUrl;
+        small.createdAt = full.createdAt;
+        small.updatedAt = full.updatedAt;
 
         return small;
     }
@@ -104,25 +131,144 @@ namespace ThemezerScreen {
         fetching_theme_by_id = true;
         exact_id_mode = true;
         exact_theme.reset();
+        lookup_id = hex_id;
 
-        ThemezerAPI::wiiu::theme(
+        lookup_token = ThemezerAPI::wiiu::theme(
             hex_id,
-            [](const WiiuThemeFull& full_theme) {
+            [hex_id](const WiiuThemeFull& full_theme) {
+                if (!exact_id_mode || hex_id != lookup_id)
+                    return;
+
                 cout << "Got exact theme by ID!" << endl;
 
                 exact_theme = full_to_small(full_theme);
                 fetching_theme_by_id = false;
-            }
+            },
+            ThemezerAPI::Category::lookup
         );
     }
 
+    PageKey current_key() {
+        return {page, sort, order, query};
+    }
+
+    // All in one request, so opening a theme from the page finds it cached.
+    void prefetch_details(const WiiuThemeSmallVec& vec) {
+        std::vector<std::string> ids;
+        for (auto& theme : vec)
+            ids.push_back(theme.hexId);
+
+        ThemezerAPI::wiiu::themes_by_id(ids, {}, ThemezerAPI::Category::prefetch_details);
+    }
+
+    void set_themes(const PageKey& key, WiiuThemeSmallVec new_themes) {
+        scroll_to_top = shown_key != key;
+        shown_key = key;
+
+        for (auto handle : thumbnails)
+            ImageLoader::release(handle);
+        thumbnails.clear();
+
+        for (auto& theme : new_themes)
+            thumbnails.push_back(ImageLoader::make_handle(theme.collagePreview.thumbUrl, 426, 240));
+
+        themes = std::move(new_themes);
+
+        prefetch_details(*themes);
+    }
+
+    void prefetch_thumbnails(const WiiuThemeSmallVec& vec) {
+        for (auto& theme : vec)
+            ImageLoader::prefetch(theme.collagePreview.thumbUrl, 426, 240);
+    }
+
+    void fetch_page(unsigned new_page);
+
+    void prefetch_next_page() {
+        if (!page_info || page_info->page >= page_info->pageCount)
+            return;
+
+        PageKey key{page + 1, sort, order, query};
+        if (next_key == key)
+            return;
+
+        next_key = key;
+        next_themes.reset();
+        next_page_info.reset();
+
+        prefetch_token = ThemezerAPI::wiiu::themes({
+                .paginationArgs = {
+                    .limit = 20,
+                    .page = page + 1,
+                },
+                .sort = sort,
+                .order = order,
+                .query = query,
+            },
+            [key](const WiiuThemeSmallVec& new_themes,
+                  const PageInfo& new_page_info)
+            {
+                if (next_key != key)
+                    return;
+
+                next_themes = new_themes;
+                next_page_info = new_page_info;
+                prefetch_thumbnails(new_themes);
+
+                // The page was turned while this was loading.
+                if (key == current_key())
+                    fetch_page(page);
+            },
+            ThemezerAPI::Category::prefetch);
+    }
+
     void fetch_page(unsigned new_page) {
         if (!new_page)
             return;
 
+        // Whatever is in the search box is used now.
+        search_at.reset();
+
         page = new_page;
+        const PageKey key = current_key();
+
+        if (ThemezerCatalog::can_serve(sort, query)) {
+            page_token.cancel();
+
+            auto [new_themes, new_page_info] = ThemezerCatalog::page(sort, order, page, 20);
+            page_info = new_page_info;
+            set_themes(key, std::move(new_themes));
 
-        ThemezerAPI::wiiu::themes({
+            is_item_count_zero = page_info->itemCount == 0;
+
+            prefetch_thumbnails(*themes);
+            prefetch_thumbnails(ThemezerCatalog::page(sort, order, page + 1, 20).first);
+            return;
+        }
+
+        if (next_key == key) {
+            if (next_themes) {
+                page_token.cancel();
+
+                set_themes(key, std::move(*next_themes));
+                page_info = std::move(next_page_info);
+                next_themes.reset();
+                next_page_info.reset();
+
+                is_item_count_zero = page_info->itemCount == 0;
+
+                prefetch_next_page();
+                return;
+            }
+
+            // The prefetch shows the page when it arrives.
+            if (prefetch_token.is_pending()) {
+                page_token.cancel();
+                return;
+            }
+        }
+
+        page_token = ThemezerAPI::wiiu::themes({
                 .paginationArgs = {
                     .limit = 20,
                     .page = page,
@@ -131,15 +277,41 @@ namespace ThemezerScreen {
                 .order = order,
                 .query = query,
             },
-            [](const WiiuThemeSmallVec& new_themes,
-               const PageInfo& new_page_info)
+            [key](const WiiuThemeSmallVec& new_themes,
+                  const PageInfo& new_page_info)
             {
+                // An update to a page that's not the current one anymore.
+                if (key != current_key())
+                    return;
+
                 page_info = new_page_info;
-                themes = new_themes;
+                set_themes(key, new_themes);
 
                 is_item_count_zero = page_info->itemCount == 0;
-                scroll_to_top = true;
-            });
+
+                // Cards further down the page come before the next page.
+                prefetch_thumbnails(new_themes);
+                prefetch_next_page();
+            },
+            ThemezerAPI::Category::page);
+    }
+
+    // A page is on its way, from a request for it or from the prefetch.
+    bool is_loading_page() {
+        if (search_at || page_token.is_pending())
+            return true;
+        return next_key == current_key() && !next_themes && prefetch_token.is_pending();
+    }
+
+    std::string downloads_label() {
+        unsigned active = 0;
+        for (auto& info : DownloadManager::get_infos())
+            if (DownloadManager::is_active(info->status.load().state))
+                ++active;
+
+        if (active)
+            return ICON_FA_DOWNLOAD " " + std::to_string(active) + "###downloads";
+        return ICON_FA_DOWNLOAD "###downloads";
     }
 
     void initialize(SDL_Renderer* renderer) {
@@ -148,10 +320,15 @@ namespace ThemezerScreen {
         themezer_logo = IMG_LoadTexture(renderer, "fs:/vol/content/ui/themezer-logo.png");
         qr_sfx = Mix_LoadWAV("fs:/vol/content/sound/qr-scan.wav");
 
+        ThemezerCatalog::sync();
         fetch_page(1);
     }
 
     void finalize() {
+        for (auto handle : thumbnails)
+            ImageLoader::release(handle);
+        thumbnails.clear();
+
         if (themezer_logo) {
             SDL_DestroyTexture(themezer_logo);
             themezer_logo = nullptr;
@@ -160,7 +337,7 @@ namespace ThemezerScreen {
         cout << "Hello from ThemezerScreen finalize!" << endl;
     }
 
-    void show(const WiiuThemeSmall& theme) {
+    void show(const WiiuThemeSmall& theme, std::optional<ImageLoader::Handle> thumbnail_handle = {}) {
         using namespace ImGui::RAII;
 
         Child theme_frame{
@@ -173,8 +350,11 @@ namespace ThemezerScreen {
         if (!theme_frame)
             return;
 
-        auto thumbnail = ImageLoader::get(theme.collagePreview.thumbUrl);
-        ImGui::Image((ImTextureID)thumbnail, {426, 240});
+        // Only looked up here, so clipped cards don't count as visible.
+        auto thumbnail = thumbnail_handle
+            ? ImageLoader::get_image(*thumbnail_handle)
+            : ImageLoader::get_image(theme.collagePreview.thumbUrl, 426, 240);
+        ImGui::Image((ImTextureID)thumbnail.texture, {426, 240}, thumbnail.uv0, thumbnail.uv1);
 
         ImGui::SameLine();
 
@@ -213,6 +393,17 @@ namespace ThemezerScreen {
         if (!themezer_content)
             return;
 
+        // The prefetch failed or was canceled, no callback will come.
+        if (next_key && !next_themes && !prefetch_token.is_pending())
+            next_key.reset();
+
+        if (search_at && std::chrono::steady_clock::now() >= *search_at) {
+            cout << "Searching: " << query << endl;
+            fetch_page(1);
+        }
+
+        const bool loading = is_loading_page();
+
         // Title
         if (themezer_logo) {
             ImGui::Image((ImTextureID)themezer_logo, {300, 86});
@@ -220,8 +411,6 @@ namespace ThemezerScreen {
 
         // Sort and Filter controls
         {
-            Disabled disable_when{ThemezerAPI::is_busy()};
-
             if (Child filter_order_search_box{
                     "FilterOrderSearchBox",
                     {700.0f, 75.0f},
@@ -235,13 +424,12 @@ namespace ThemezerScreen {
 
                 ImGui::SetNextItemWidth(300.0f);
                 if (ImGui::InputTextWithHint("##network_search"s, "Search..."s, query)) {
-                    cout << "Searching: " << query << endl;
-
                     exact_id_mode = false;
                     exact_theme.reset();
                     fetching_theme_by_id = false;
+                    lookup_token.cancel();
 
-                    fetch_page(1);
+                    search_at = std::chrono::steady_clock::now() + search_delay;
                 }
 
                 ImGui::SameLine();
@@ -252,6 +440,12 @@ namespace ThemezerScreen {
 
                 ImGui::SameLine();
 
+                if (ImGui::Button(downloads_label())) {
+                    DownloadsPopup::show();
+                }
+
+                ImGui::SameLine();
+
                 ImGui::SetNextItemWidth(220);
                 if (Combo sort_combo{"##sort_combo"s, sort_to_label(sort)}) {
                     for (auto new_sort : ThemezerAPI::ItemSortList) {
@@ -285,16 +479,13 @@ namespace ThemezerScreen {
 
         // Navigation controls
         {
-            Disabled disabled_when{ThemezerAPI::is_busy() || exact_id_mode};
+            Disabled disabled_when{exact_id_mode};
 
             auto& new_page_info = page_info;
 
+            // Going by the requested page, it can be turned again while it loads.
             {
-                bool first_page = true;
-                if (new_page_info)
-                    first_page = new_page_info->page == 1;
-
-                Disabled disable_when{first_page};
+                Disabled disable_when{page <= 1};
 
                 if (ImGui::Button(ICON_FA_CHEVRON_LEFT))
                     fetch_page(page - 1);
@@ -306,7 +497,7 @@ namespace ThemezerScreen {
                 ImGui::Text("ID Result");
             }
             else if (new_page_info) {
-                ImGui::Text("Page %u/%u", new_page_info->page, new_page_info->pageCount);
+                ImGui::Text("Page %u/%u", page, new_page_info->pageCount);
             }
 
             ImGui::SameLine();
@@ -314,17 +505,22 @@ namespace ThemezerScreen {
             {
                 bool last_page = true;
                 if (new_page_info)
-                    last_page = new_page_info->page == new_page_info->pageCount;
+                    last_page = page >= new_page_info->pageCount;
 
                 Disabled disable_when{last_page};
 
                 if (ImGui::Button(ICON_FA_CHEVRON_RIGHT))
                     fetch_page(page + 1);
             }
+
+            if (loading && !exact_id_mode) {
+                ImGui::SameLine();
+                ImGui::Text(ICON_FA_SPINNER);
+            }
         }
 
         // Trigger exact ID lookup after normal search returns 0 results
-        if (!ThemezerAPI::is_busy() &&
+        if (!loading &&
             is_item_count_zero &&
             query.starts_with('T') &&
             !fetching_theme_by_id &&
@@ -339,8 +535,6 @@ namespace ThemezerScreen {
 
         // Themes List
         {
-            Disabled disable_when{ThemezerAPI::is_busy()};
-
 #ifdef DEBUG_BG_COLOR
             StyleColor brown_bg{ImGuiCol_ChildBg, {0.3, 0.3, 0.0, 1.0}};
 #endif
@@ -352,9 +546,10 @@ namespace ThemezerScreen {
                 }
 
                 if (exact_id_mode) {
-                    if (fetching_theme_by_id) {
+                    if (fetching_theme_by_id && lookup_token.is_pending()) {
                         ImGui::Text("Searching by exact Themezer ID...");
                         if (ImGui::Button("Cancel Search")) {
+                            lookup_token.cancel();
                             exact_id_mode = false;
                             query = "";
                             fetch_page(1);
@@ -380,8 +575,8 @@ namespace ThemezerScreen {
                         ImGui::Text("Waiting for Themezer to respond...");
                     }
                     else {
-                        for (auto& theme : *new_themes)
-                            show(theme);
+                        for (std::size_t i = 0; i < new_themes->size(); ++i)
+                            show((*new_themes)[i], thumbnails[i]);
                     }
                 }
             }
@@ -389,6 +584,7 @@ namespace ThemezerScreen {
 
         ThemeDetailsPopup::process_ui();
         DownloadThemePopup::process_ui();
+        DownloadsPopup::process_ui();
         InstallThemePopup::process_ui();
         QRCodePopup::process_ui();
     }
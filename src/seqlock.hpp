@@ -0,0 +1,102 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SEQLOCK_HPP
+#define SEQLOCK_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+
+// A value with a single writer and any number of readers, none of them ever blocks.
+//
+// Readers retry if the writer was in the middle of a store(), so this is meant for
+// small values that are updated often, like progress counters.
+template<typename T>
+requires std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>
+class seqlock {
+
+    using word_type = std::uintptr_t;
+
+    static constexpr std::size_t num_words = (sizeof(T) + sizeof(word_type) - 1)
+                                             / sizeof(word_type);
+
+    std::atomic<std::uint32_t> sequence = 0;
+    std::array<std::atomic<word_type>, num_words> words;
+
+public:
+
+    seqlock()
+        noexcept :
+        seqlock{T{}}
+    {}
+
+
+    explicit
+    seqlock(const T& value)
+        noexcept
+    {
+        store(value);
+    }
+
+
+    seqlock(const seqlock&) = delete;
+
+
+    // Only one thread may call this.
+    void
+    store(const T& value)
+        noexcept
+    {
+        std::array<word_type, num_words> buf{};
+        std::memcpy(buf.data(), &value, sizeof(T));
+
+        auto seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t i = 0; i < num_words; ++i)
+            words[i].store(buf[i], std::memory_order_relaxed);
+
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+
+    [[nodiscard]]
+    T
+    load()
+        const noexcept
+    {
+        std::array<word_type, num_words> buf;
+
+        for (;;) {
+            auto before = sequence.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            for (std::size_t i = 0; i < num_words; ++i)
+                buf[i] = words[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T result;
+        std::memcpy(static_cast<void*>(&result), buf.data(), sizeof(T));
+        return result;
+    }
+
+}; // class seqlock
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "sha256.hpp"
+
+
+namespace {
+
+    constexpr std::array<std::uint32_t, 64> round_constants = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+
+    constexpr std::array<std::uint32_t, 8> initial_state = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+
+
+    std::uint32_t
+    load_be32(const std::uint8_t* p)
+        noexcept
+    {
+        return (std::uint32_t{p[0]} << 24) |
+               (std::uint32_t{p[1]} << 16) |
+               (std::uint32_t{p[2]} <<  8) |
+               (std::uint32_t{p[3]} <<  0);
+    }
+
+} // namespace
+
+
+sha256::sha256()
+    noexcept
+{
+    reset();
+}
+
+
+void
+sha256::reset()
+    noexcept
+{
+    state = initial_state;
+    block_size = 0;
+    total_size = 0;
+}
+
+
+void
+sha256::compress(const std::uint8_t* chunk)
+    noexcept
+{
+    using std::rotr;
+
+    std::uint32_t w[64];
+    for (unsigned i = 0; i < 16; ++i)
+        w[i] = load_be32(chunk + 4 * i);
+    for (unsigned i = 16; i < 64; ++i) {
+        std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = state;
+
+    for (unsigned i = 0; i < 64; ++i) {
+        std::uint32_t S1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        std::uint32_t ch = (e & f) ^ (~e & g);
+        std::uint32_t t1 = h + S1 + ch + round_constants[i] + w[i];
+        std::uint32_t S0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        std::uint32_t t2 = S0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+
+void
+sha256::update(const void* data,
+               std::size_t size)
+    noexcept
+{
+    auto input = static_cast<const std::uint8_t*>(data);
+    total_size += size;
+
+    if (block_size) {
+        std::size_t n = std::min(size, block.size() - block_size);
+        std::memcpy(block.data() + block_size, input, n);
+        block_size += n;
+        input += n;
+        size -= n;
+        if (block_size < block.size())
+            return;
+        compress(block.data());
+        block_size = 0;
+    }
+
+    // Hash whole blocks straight from the input, no copying.
+    while (size >= block.size()) {
+        compress(input);
+        input += block.size();
+        size -= block.size();
+    }
+
+    if (size) {
+        std::memcpy(block.data(), input, size);
+        block_size = size;
+    }
+}
+
+
+sha256::digest_type
+sha256::finish()
+    noexcept
+{
+    const std::uint64_t total_bits = total_size * 8;
+
+    block[block_size++] = 0x80;
+    if (block_size > 56) {
+        std::memset(block.data() + block_size, 0, block.size() - block_size);
+        compress(block.data());
+        block_size = 0;
+    }
+    std::memset(block.data() + block_size, 0, 56 - block_size);
+    for (unsigned i = 0; i < 8; ++i)
+        block[56 + i] = static_cast<std::uint8_t>(total_bits >> (56 - 8 * i));
+    compress(block.data());
+
+    digest_type result;
+    for (unsigned i = 0; i < 8; ++i) {
+        result[4 * i + 0] = static_cast<std::uint8_t>(state[i] >> 24);
+        result[4 * i + 1] = static_cast<std::uint8_t>(state[i] >> 16);
+        result[4 * i + 2] = static_cast<std::uint8_t>(state[i] >>  8);
+        result[4 * i + 3] = static_cast<std::uint8_t>(state[i] >>  0);
+    }
+    return result;
+}
+
+
+std::string
+sha256::to_hex(const digest_type& digest)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string result;
+    result.reserve(2 * digest.size());
+    for (auto b : digest) {
+        result += digits[b >> 4];
+        result += digits[b & 0xf];
+    }
+    return result;
+}
@@ -0,0 +1,65 @@
+/*
+ * Themiify - A theme manager for the Nintendo Wii U
+ * Copyright (C) 2026 Fangal-Airbag
+ * Copyright (C) 2026 AlphaCraft9658
+ * Copyright (C) 2026  Daniel K. O. <dkosmari>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#ifndef SHA256_HPP
+#define SHA256_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Incremental SHA-256 (FIPS 180-4), so it can be fed from a curl write callback.
+class sha256 {
+
+    std::array<std::uint32_t, 8> state;
+    std::array<std::uint8_t, 64> block;
+    std::size_t block_size;
+    std::uint64_t total_size;
+
+    void
+    compress(const std::uint8_t* chunk)
+        noexcept;
+
+public:
+
+    using digest_type = std::array<std::uint8_t, 32>;
+
+
+    sha256()
+        noexcept;
+
+
+    void
+    reset()
+        noexcept;
+
+
+    void
+    update(const void* data,
+           std::size_t size)
+        noexcept;
+
+
+    // Note: the object must be reset() before it can be used again.
+    [[nodiscard]]
+    digest_type
+    finish()
+        noexcept;
+
+
+    [[nodiscard]]
+    static
+    std::string
+    to_hex(const digest_type& digest);
+
+}; // class sha256
+
+#endif
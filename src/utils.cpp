@@ -1,3 +1,4 @@
+#include <chrono>
 #include <cstdio>
 #include <iostream>
 #include <ranges>
@@ -113,3 +114,17 @@ std::filesystem::path sanitize(const std::filesystem::path& input) {
     }
     return output;
 }
+
+std::optional<std::int64_t> ParseISO8601(const std::string& text) {
+    int y, mo, d, h, mi, sec;
+    if (std::sscanf(text.c_str(), "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &sec) != 6)
+        return {};
+
+    using namespace std::chrono;
+    year_month_day date{year{y}, month(mo), day(d)};
+    if (!date.ok())
+        return {};
+
+    auto t = sys_days{date} + hours{h} + minutes{mi} + seconds{sec};
+    return duration_cast<seconds>(t.time_since_epoch()).count();
+}
@@ -12,6 +12,7 @@
 #include <cstdint>
 #include <string>
 #include <filesystem>
+#include <optional>
 
 #ifndef THEMIIFY_VERSION
 #define THEMIIFY_VERSION "?.?"
@@ -23,6 +24,7 @@ inline const std::filesystem::path SD_ROOT = "fs:/vol/external01";
 inline const std::filesystem::path THEMIIFY_ROOT = SD_ROOT / "themiify";
 inline const std::filesystem::path THEMIIFY_INSTALLED_THEMES = THEMIIFY_ROOT / "installed";
 inline const std::filesystem::path THEMIIFY_THUMBNAILS = THEMIIFY_ROOT / "cache/thumbnails";
+inline const std::filesystem::path THEMIIFY_HTTP_CACHE = THEMIIFY_ROOT / "cache/http";
 
 inline const std::filesystem::path THEMES_ROOT = SD_ROOT / "wiiu/themes";
 
@@ -40,3 +42,6 @@ void DeletePath(const std::filesystem::path& inputPath);
 
 std::filesystem::path sanitize_element(const std::filesystem::path& input);
 std::filesystem::path sanitize(const std::filesystem::path& input);
+
+// Seconds since the epoch, of a UTC time like "2024-05-01T12:34:56.789Z".
+std::optional<std::int64_t> ParseISO8601(const std::string& text);